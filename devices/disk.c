@@ -84,7 +84,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -209,44 +209,95 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
+	disk_read_multiple (d, sec_no, 1, &buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_write_multiple (d, sec_no, 1, &buffer);
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D, sector
+   SEC_NO + I into BUFFERS[I], each of which must have room for
+   DISK_SECTOR_SIZE bytes.  Up to DISK_MULTIPLE_MAX sectors are
+   read with a single command, which costs one command setup and
+   one interrupt per sector instead of a full round trip each.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *const buffers[]) {
 	struct channel *c;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (buffers != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
+	while (cnt > 0) {
+		size_t n = cnt < DISK_MULTIPLE_MAX ? cnt : DISK_MULTIPLE_MAX;
+		size_t i;
+
+		select_sector (d, sec_no, n);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (i = 0; i < n; i++) {
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu,
+						d->name, sec_no + (disk_sector_t) i);
+			ASSERT (buffers[i] != NULL);
+			input_sector (c, buffers[i]);
+		}
+		d->read_cnt += n;
+		sec_no += n;
+		buffers += n;
+		cnt -= n;
+	}
 	lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
+/* Writes the CNT sectors starting at SEC_NO to disk D, sector
+   SEC_NO + I from BUFFERS[I], each of which must contain
    DISK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+   acknowledged receiving all of the data.  Like
+   disk_read_multiple(), issues one command per DISK_MULTIPLE_MAX
+   sectors.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *const buffers[]) {
 	struct channel *c;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (buffers != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	while (cnt > 0) {
+		size_t n = cnt < DISK_MULTIPLE_MAX ? cnt : DISK_MULTIPLE_MAX;
+		size_t i;
+
+		select_sector (d, sec_no, n);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (i = 0; i < n; i++) {
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu,
+						d->name, sec_no + (disk_sector_t) i);
+			ASSERT (buffers[i] != NULL);
+			output_sector (c, buffers[i]);
+			sema_down (&c->completion_wait);
+		}
+		d->write_cnt += n;
+		sec_no += n;
+		buffers += n;
+		cnt -= n;
+	}
 	lock_release (&c->lock);
 }
 
@@ -402,17 +453,19 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.)  A count of 256 is
+   written as 0, as ATA expects. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= DISK_MULTIPLE_MAX);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt & 0xff);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -1,12 +1,14 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,14 +19,61 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency, and the counter value that makes it
+   interrupt TIMER_FREQ times per second (rounded to nearest). */
+#define PIT_HZ 1193180
+#define PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot countdown the 16-bit counter can hold, in
+   timer ticks. */
+#define ONESHOT_MAX_TICKS (0xffff / PIT_COUNT)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* -tickless: While only the idle thread can run, replace the
+   periodic tick by a one-shot countdown to the next wakeup. */
+bool timer_tickless;
+
+/* One-shot countdown that replaces the periodic tick, either to
+   skip ticks while idle or to end a sub-tick sleep early.  If
+   ONESHOT_ARMED, a countdown of ONESHOT_COUNT PIT cycles was
+   started ONESHOT_PHASE cycles after the last tick counted in
+   TICKS. */
+static bool oneshot_armed;
+static uint16_t oneshot_count;
+static uint32_t oneshot_phase;
+
+/* Number of ticks over which the TSC is calibrated. */
+#define TSC_CALIB_TICKS (TIMER_FREQ / 10)
+
+/* Time-stamp counter clock, set up by timer_calibrate().
+   TSC_MULT converts TSC cycles to nanoseconds in 32.32 fixed
+   point.  TSC_BASE was read at the start of tick
+   TSC_BASE_TICKS. */
+static uint64_t tsc_hz;
+static uint64_t tsc_mult;
+static uint64_t tsc_base;
+static int64_t tsc_base_ticks;
+
+/* Threads in a sub-tick sleep, by ascending wakeup_ns. */
+static struct list hr_sleepers;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static void pit_periodic (void);
+static void pit_oneshot (uint16_t count);
+static uint16_t pit_read (bool *expired);
+static void oneshot_arm (uint32_t phase, uint32_t count);
+static void advance_ticks (int64_t n);
+static void hr_sleep (int64_t deadline);
+static void hr_wake (void);
+static void hr_arm (void);
+static bool wakeup_ns_less (const struct list_elem *,
+		const struct list_elem *, void *aux);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -34,21 +83,18 @@ static void real_time_sleep (int64_t num, int32_t denom);
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
-
+	list_init (&hr_sleepers);
+	pit_periodic ();
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   and the time-stamp counter clock behind timer_now(). */
 void
 timer_calibrate (void) {
 	unsigned high_bit, test_bit;
+	uint64_t tsc_start;
+	int64_t start;
 
 	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
@@ -68,6 +114,38 @@ timer_calibrate (void) {
 			loops_per_tick |= test_bit;
 
 	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+	/* Count TSC cycles across whole ticks. */
+	start = ticks;
+	while (ticks == start)
+		barrier ();
+	tsc_start = rdtsc ();
+	start = ticks;
+	while (ticks - start < TSC_CALIB_TICKS)
+		barrier ();
+	tsc_base = rdtsc ();
+	tsc_base_ticks = start + TSC_CALIB_TICKS;
+	tsc_mult = 0;
+	tsc_hz = (tsc_base - tsc_start) * TIMER_FREQ / TSC_CALIB_TICKS;
+	if (tsc_hz != 0)
+		tsc_mult = (1000000000ULL << 32) / tsc_hz;
+	printf ("TSC: %'"PRIu64" Hz.\n", tsc_hz);
+}
+
+/* Returns the number of nanoseconds since the OS booted.  Until
+   timer_calibrate() has run this has only tick resolution. */
+int64_t
+timer_now (void) {
+	if (tsc_mult == 0)
+		return timer_ticks () * NSEC_PER_TICK;
+	return tsc_base_ticks * NSEC_PER_TICK + timer_tsc_to_ns (rdtsc () - tsc_base);
+}
+
+/* Converts CYCLES time-stamp counter cycles to nanoseconds.
+   Returns 0 until timer_calibrate() has run. */
+int64_t
+timer_tsc_to_ns (uint64_t cycles) {
+	return ((unsigned __int128) cycles * tsc_mult) >> 32;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -113,6 +191,63 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, replaces the periodic tick by
+   a single countdown that expires at the next thread wakeup (or
+   as close to it as the counter allows). */
+void
+timer_idle_enter (void) {
+	int64_t delta;
+	uint16_t phase;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!timer_tickless || oneshot_armed || !list_empty (&hr_sleepers))
+		return;
+
+	delta = thread_next_wakeup () - ticks;
+	if (delta > ONESHOT_MAX_TICKS)
+		delta = ONESHOT_MAX_TICKS;
+	if (delta <= 1)
+		return;
+
+	/* Keep the tick phase: count from the last tick, not from
+	   now. */
+	phase = PIT_COUNT - pit_read (NULL);
+	oneshot_arm (phase, delta * PIT_COUNT - phase);
+}
+
+/* Called by the idle thread, with interrupts off, after an
+   interrupt woke it up.  If a one-shot countdown is still
+   running, catches TICKS up with the time spent halted and lets
+   the countdown expire at the next tick boundary instead, or at
+   the next sub-tick wakeup if that is sooner.  The timer
+   interrupt restarts the periodic tick at the boundary. */
+void
+timer_idle_exit (void) {
+	bool expired;
+	uint32_t since_tick;
+	uint16_t remaining;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!oneshot_armed)
+		return;
+
+	/* If the countdown already expired, its interrupt is pending
+	   and will do the accounting as soon as interrupts are on. */
+	remaining = pit_read (&expired);
+	if (expired)
+		return;
+
+	since_tick = oneshot_phase + (oneshot_count - remaining);
+	advance_ticks (since_tick / PIT_COUNT);
+
+	since_tick %= PIT_COUNT;
+	oneshot_arm (since_tick, PIT_COUNT - since_tick);
+	hr_arm ();
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
@@ -122,23 +257,173 @@ timer_print_stats (void) {
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
-	ticks++;
-	thread_tick ();
-	// start P1-3
-	if (thread_mlfqs) {
-		mlfqs_increment_recent_cpu ();
-		if (ticks % TIMER_FREQ == 0) {
+	int64_t elapsed = 1;
+
+	if (oneshot_armed) {
+		/* A one-shot countdown expired.  It may have covered
+		   several ticks, or none.  Restart the periodic tick if
+		   it ended on a tick boundary, otherwise count down to
+		   the boundary. */
+		uint32_t end = oneshot_phase + oneshot_count;
+
+		oneshot_armed = false;
+		elapsed = end / PIT_COUNT;
+		if (end % PIT_COUNT == 0)
+			pit_periodic ();
+		else
+			oneshot_arm (end % PIT_COUNT, PIT_COUNT - end % PIT_COUNT);
+	}
+	advance_ticks (elapsed);
+	hr_wake ();
+}
+
+/* Advances the tick count by N ticks, doing the per-tick
+   bookkeeping for each of them, then wakes up due sleepers. */
+static void
+advance_ticks (int64_t n) {
+	while (n-- > 0) {
+		ticks++;
+		thread_tick ();
+		// start P1-3
+		if (thread_mlfqs) {
+			mlfqs_increment_recent_cpu ();
+			if (ticks % TIMER_FREQ == 0) {
 				mlfqs_load_avg ();
-				mlfqs_update_recent_cpu (); 
+				mlfqs_update_recent_cpu ();
+			}
+			if (ticks % 4 == 0) {
+				mlfqs_update_priority ();
 			}
-		if (ticks % 4 == 0) {
-			mlfqs_update_priority ();
 		}
+		// end P1-3
 	}
-	// end P1-3
 	thread_awake (ticks); //P1-1
 }
 
+/* Starts a one-shot countdown of COUNT PIT cycles, PHASE cycles
+   after the last tick counted in TICKS. */
+static void
+oneshot_arm (uint32_t phase, uint32_t count) {
+	ASSERT (count > 0 && count <= 0xffff);
+
+	oneshot_armed = true;
+	oneshot_phase = phase;
+	oneshot_count = count;
+	pit_oneshot (count);
+}
+
+/* Puts the running thread to sleep until timer_now() reaches
+   DEADLINE, which should be less than a tick away. */
+static void
+hr_sleep (int64_t deadline) {
+	struct thread *t = thread_current ();
+	enum intr_level old_level;
+
+	old_level = intr_disable ();
+	t->wakeup_ns = deadline;
+	list_insert_ordered (&hr_sleepers, &t->elem, wakeup_ns_less, NULL);
+	hr_arm ();
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Wakes up the sub-tick sleepers whose deadline has passed, and
+   arms the countdown for the next one.  Called from the timer
+   interrupt. */
+static void
+hr_wake (void) {
+	/* Anything due within one PIT cycle is due now. */
+	int64_t now = timer_now () + 1000000000 / PIT_HZ;
+	bool woke = false;
+
+	while (!list_empty (&hr_sleepers)) {
+		struct thread *t = list_entry (list_front (&hr_sleepers),
+				struct thread, elem);
+		if (t->wakeup_ns > now)
+			break;
+		list_pop_front (&hr_sleepers);
+		thread_unblock (t);
+		woke = true;
+	}
+	if (woke && thread_should_yield ())
+		intr_yield_on_return ();
+	hr_arm ();
+}
+
+/* If the earliest sub-tick sleeper is due before the timer would
+   otherwise interrupt, moves the interrupt up to its deadline. */
+static void
+hr_arm (void) {
+	struct thread *t;
+	uint32_t since_tick, until_next;
+	int64_t wait_ns;
+	uint64_t count;
+	bool expired;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (list_empty (&hr_sleepers))
+		return;
+	t = list_entry (list_front (&hr_sleepers), struct thread, elem);
+
+	/* Where the PIT is now, relative to the last tick. */
+	if (oneshot_armed) {
+		uint16_t remaining = pit_read (&expired);
+		if (expired)
+			return;             /* Interrupt pending; it rearms. */
+		since_tick = oneshot_phase + (oneshot_count - remaining);
+		until_next = remaining;
+	} else {
+		until_next = pit_read (NULL);
+		since_tick = PIT_COUNT - until_next;
+	}
+
+	wait_ns = t->wakeup_ns - timer_now ();
+	count = wait_ns <= 0 ? 1 : DIV_ROUND_UP ((uint64_t) wait_ns * PIT_HZ, 1000000000);
+	if (count < until_next)
+		oneshot_arm (since_tick, count);
+}
+
+/* Orders threads by ascending wakeup_ns. */
+static bool
+wakeup_ns_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->wakeup_ns
+		< list_entry (b, struct thread, elem)->wakeup_ns;
+}
+
+/* Programs counter 0 to interrupt TIMER_FREQ times per second. */
+static void
+pit_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_COUNT & 0xff);
+	outb (0x40, PIT_COUNT >> 8);
+}
+
+/* Programs counter 0 to interrupt once, COUNT cycles from now. */
+static void
+pit_oneshot (uint16_t count) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns the current value of counter 0.  If EXPIRED is
+   nonnull, also stores in it whether the counter's output is
+   high, which in mode 0 means that the countdown reached zero. */
+static uint16_t
+pit_read (bool *expired) {
+	uint8_t status, lo, hi;
+
+	outb (0x43, 0xc2);    /* Read-back: latch status and count of counter 0. */
+	status = inb (0x40);
+	lo = inb (0x40);
+	hi = inb (0x40);
+	if (expired != NULL)
+		*expired = (status & 0x80) != 0;
+	return lo | (hi << 8);
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -188,6 +473,12 @@ real_time_sleep (int64_t num, int32_t denom) {
 		   processes. */
 		timer_sleep (ticks);
 
+	} else if (tsc_mult != 0) {
+		/* Sleep for less than a tick, woken by a one-shot
+		   countdown instead of the next tick. */
+		ASSERT (1000000000 % denom == 0);
+		hr_sleep (timer_now () + num * (1000000000 / denom));
+
 	} else {
 		/* Otherwise, use a busy-wait loop for more accurate
 		   sub-tick timing.  We scale the numerator and denominator
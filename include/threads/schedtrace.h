@@ -0,0 +1,32 @@
+#ifndef THREADS_SCHEDTRACE_H
+#define THREADS_SCHEDTRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Kinds of scheduler events. */
+enum sched_event_type {
+	SCHED_BLOCK,        /* Thread blocked.  ARG is the caller's address. */
+	SCHED_UNBLOCK,      /* Thread made ready.  ARG is the waker's tid. */
+	SCHED_PICK,         /* Thread chosen to run.  ARG is run queue depth. */
+	SCHED_LAUNCH,       /* Switched to thread.  ARG is previous tid. */
+	SCHED_DL_MISS,      /* Deadline passed.  ARG is the lateness in ns. */
+	SCHED_DL_THROTTLE,  /* Deadline thread ran out of budget.  ARG is
+	                       the time left to its deadline in ns. */
+	SCHED_EVENT_CNT
+};
+
+/* If true, the scheduler records events.
+   Controlled by kernel command-line option "-schedtrace". */
+extern bool schedtrace_enabled;
+
+void schedtrace_record (enum sched_event_type, const struct thread *,
+		int64_t arg);
+void schedtrace_ready (struct thread *);
+void schedtrace_pick (struct thread *, size_t depth);
+void schedtrace_print_stats (void);
+
+#endif /* threads/schedtrace.h */
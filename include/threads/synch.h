@@ -1,13 +1,15 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include "threads/interrupt.h"
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, by priority. */
 };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -20,6 +22,8 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct heap_elem elem;      /* Element in holder's `locks' heap. */
+	int priority;               /* Highest waiter priority, or PRI_MIN - 1. */
 };
 
 void lock_init (struct lock *);
@@ -30,7 +34,7 @@ bool lock_held_by_current_thread (const struct lock *);
 
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct heap waiters;        /* Waiting threads, by priority. */
 };
 
 void cond_init (struct condition *);
@@ -38,13 +42,26 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Spin lock.  Busy-waits instead of sleeping and keeps
+   interrupts disabled while held, so it may protect data that is
+   touched by interrupt handlers or by more than one CPU. */
+struct spinlock {
+	volatile int locked;        /* Nonzero while held. */
+	enum intr_level old_level;  /* Interrupt level before acquiring. */
+};
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+
 // start P1-2
-bool sema_desc_priority (struct list_elem *, struct list_elem *, void *);
+void waiter_requeue (struct thread *);
 // end P1-2
 
 // start P1-2 : donation
-void update_priority (void);
-void remove_lock (struct lock *);
+void update_priority (struct thread *);
+bool lock_less_priority (const struct heap_elem *, const struct heap_elem *,
+		void *);
 // end P1-2 : donation
 
 /* Optimization barrier.
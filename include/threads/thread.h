@@ -110,11 +110,35 @@ struct thread {
 	struct intr_frame tf;               /* Information for switching */
 	unsigned magic;                     /* Detects stack overflow. */
 	int64_t wakeup_time; //P1-1
+	int64_t wakeup_ns;                  /* Sub-tick sleep deadline, see timer.c. */
 	struct lock *lock; //P1-2 : donation
-	struct list donate; //P1-2 : donation
-	struct list_elem donate_elem; //P1-2 : donation
+	struct heap_elem wait_elem;         /* Element in a semaphore's waiters. */
+	struct semaphore *wait_sema;        /* Semaphore being waited on, if any. */
+	struct condition *wait_cond;        /* Condition being waited on, if any. */
+	struct heap_elem *wait_cond_elem;   /* This thread's entry in WAIT_COND. */
+	uint64_t wait_seq;                  /* Arrival order among waiters. */
+	uint64_t ready_tsc;                 /* When it became ready, for tracing. */
+	uint64_t cpu_cycles;                /* TSC cycles spent running. */
+
+	/* Deadline class, see thread_set_deadline().  Owned by thread.c. */
+	int64_t dl_runtime;                 /* Budget per period, in ns, or 0. */
+	int64_t dl_period;                  /* Period, in ns. */
+	int64_t dl_deadline;                /* Current absolute deadline, in ns. */
+	int64_t dl_budget;                  /* Budget left before DL_DEADLINE. */
+	int64_t dl_missed;                  /* Last deadline reported missed. */
+	uint64_t dl_bw;                     /* Reserved bandwidth, see thread.c. */
+	bool dl_throttled;                  /* Waiting for budget replenishment? */
+	struct heap_elem dl_elem;           /* Element in a deadline run queue. */
+
+	/* Fair-share scheduler ("-fair").  Owned by thread.c. */
+	int64_t vruntime;                   /* Weighted ns of CPU time used. */
+	struct heap_elem fair_elem;         /* Element in a fair run queue. */
+	struct heap locks;                  /* Held locks, by waiter priority. */
 	int nice; //P1-3
 	int recent_cpu; //P1-3
+	struct list_elem allelem;           /* List element for all threads list. */
+	struct list_elem dirty_elem;        /* Element in MLFQS dirty list. */
+	bool mlfqs_dirty;                   /* Priority needs recomputing? */
 	// start P2-3
 	int exit_status;
 	struct list child;
@@ -140,6 +164,10 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler.
+   Controlled by kernel command-line option "-fair". */
+extern bool thread_fair;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -160,6 +188,7 @@ void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 void thread_sleep (int64_t ticks); // P1-1
 void thread_awake (int64_t ticks); // P1-1
+int64_t thread_next_wakeup (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
@@ -169,17 +198,16 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+bool thread_set_deadline (int64_t runtime, int64_t period);
+
 void do_iret (struct intr_frame *tf);
 
 // start P1-2
-bool thread_desc_priority (struct list_elem *, struct list_elem *, void *);
+bool thread_should_yield (void);
 void thread_comp_priority (void);
+void thread_change_priority (struct thread *, int priority);
 // end P1-2
 
-// start P1-2 : donation
-bool donate_desc_priority (struct list_elem *, struct list_elem *, void *);
-void reset_priority (void);
-// end P1-2 : donation
 
 // start P1-3
 void mlfqs_priority (struct thread *);
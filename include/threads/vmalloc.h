@@ -0,0 +1,23 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernel virtual range for vmalloc().  It lies in the same pml4
+   slot as the kernel's direct map, so every page map created by
+   pml4_create() shares its page tables with base_pml4. */
+#define VMALLOC_START 0xc000000000
+#define VMALLOC_END   (VMALLOC_START + (64 << 20))
+
+/* Returns true if VADDR lies in the vmalloc() range. */
+#define is_vmalloc_vaddr(vaddr) \
+	((uint64_t) (vaddr) >= VMALLOC_START && (uint64_t) (vaddr) < VMALLOC_END)
+
+void vmalloc_init (void);
+void *vmalloc (size_t size);
+void *vzalloc (size_t size);
+void vfree (void *);
+
+#endif /* threads/vmalloc.h */
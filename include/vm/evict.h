@@ -0,0 +1,32 @@
+#ifndef VM_EVICT_H
+#define VM_EVICT_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame;
+struct page;
+
+/* A list of frames or of evicted ("ghost") pages kept by a
+ * replacement policy, with its length. */
+struct evict_list {
+	struct list list;
+	size_t cnt;
+};
+
+bool evict_set_policy (const char *name);
+void evict_init (void);
+
+/* The following are called with the frame table's lock held. */
+void evict_add (struct frame *, struct page *);
+void evict_share (struct frame *);
+void evict_remove (struct frame *, bool evicted);
+struct frame *evict_victim (void);
+void evict_forget (struct page *);
+void evict_count_fault (struct page *);
+void evict_count_eviction (struct page *, bool written);
+
+void evict_print_stats (void);
+
+#endif /* vm/evict.h */
@@ -0,0 +1,28 @@
+#ifndef VM_IMAGE_H
+#define VM_IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct frame;
+struct inode;
+
+/* Marks the read-only pages of an executable, which the image
+ * cache shares between the processes running it. */
+#define VM_IMAGE VM_MARKER_1
+
+void image_init (void);
+
+/* The following are called with the frame table's lock held. */
+struct frame *image_lookup (struct inode *, off_t ofs, size_t read_bytes);
+void image_add (struct frame *, struct inode *, off_t ofs,
+		size_t read_bytes);
+void image_forget (struct frame *);
+struct frame *image_release (struct frame *);
+struct frame *image_reclaim (void);
+
+void image_print_stats (void);
+
+#endif /* vm/image.h */
@@ -0,0 +1,23 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct disk;
+
+/* Identifies a page-sized slot on the swap disk. */
+typedef size_t swap_slot_t;
+#define SWAP_SLOT_NONE ((swap_slot_t) -1)
+
+/* Most pages written to swap in one transfer. */
+#define SWAP_CLUSTER 8
+
+void swap_init (struct disk *);
+size_t swap_write (void *const pages[], size_t cnt, swap_slot_t slots[]);
+void swap_read (swap_slot_t, void *page);
+void swap_dup (swap_slot_t);
+void swap_free (swap_slot_t);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
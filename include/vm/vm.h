@@ -34,6 +34,9 @@ enum vm_type {
 
 struct page_operations;
 struct thread;
+struct evict_list;
+struct image_entry;
+struct fa_read;
 
 #define VM_TYPE(type) ((type) & 7)
 
@@ -51,8 +54,11 @@ struct page {
 	struct hash_elem hash_elem;
 	bool writable;
 	// P3-1 end
-	bool parent_writable; // P3-extra
-
+	struct thread *owner;          /* Thread whose page table maps it. */
+	struct list_elem frame_elem;   /* Element in frame's reverse map. */
+	bool evicted;                  /* Evicted since last brought in? */
+	struct evict_list *ghost;      /* Policy's list of evicted pages. */
+	struct list_elem ghost_elem;   /* Element in GHOST. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -69,8 +75,14 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva; // kernel virtual address
-	struct page *page;
-	struct list_elem frame_elem;
+	struct list pages;             /* Reverse map: pages mapped here. */
+	unsigned page_cnt;             /* Number of pages in PAGES. */
+	bool pinned;                   /* Being filled or evicted? */
+	struct list_elem frame_elem;   /* Element in the frame table. */
+	struct evict_list *evict_list; /* Replacement policy's list. */
+	struct list_elem evict_elem;   /* Element in EVICT_LIST. */
+	int64_t last_use;              /* Ticks when last seen referenced. */
+	struct image_entry *image;     /* Image cache entry, or null. */
 };
 
 /* The function table for page operations.
@@ -95,6 +107,9 @@ struct page_operations {
  * All designs up to you for this. */
 struct supplemental_page_table {
 	struct hash spt_hash;
+	void *fa_next;        /* Where a sequential fault would come next. */
+	size_t fa_window;     /* Pages to populate per fault. */
+	struct fa_read *fa_read;  /* Data read by vm_fault_around(), or null. */
 };
 // 3-1 end
 
@@ -108,6 +123,8 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
+extern struct kmem_cache *lazy_aux_cache;
+
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
@@ -119,5 +136,6 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
+off_t vm_file_read_at (struct file *, void *, off_t size, off_t ofs);
 
 #endif  /* VM_VM_H */
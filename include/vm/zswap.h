@@ -0,0 +1,19 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "vm/swap.h"
+
+/* Compressed in-memory tier in front of the swap disk.
+ * Called by vm/swap.c only, with its lock held. */
+void zswap_init (size_t slot_cnt);
+bool zswap_store (swap_slot_t, const void *page);
+bool zswap_load (swap_slot_t, void *page);
+bool zswap_contains (swap_slot_t);
+void zswap_invalidate (swap_slot_t);
+bool zswap_needs_room (void);
+size_t zswap_shrink (swap_slot_t slots[], void *pages[], size_t max);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
@@ -0,0 +1,198 @@
+/* Priority queue.
+
+   See heap.h for basic information.  The two-pass pairing used
+   by merge_pairs() is from Fredman, Sedgewick, Sleator and
+   Tarjan, "The Pairing Heap: A New Form of Self-Adjusting
+   Heap", Algorithmica 1 (1986). */
+
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *link (struct heap *, struct heap_elem *,
+		struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+static void detach (struct heap_elem *);
+
+/* Initializes heap H as empty, to compare heap elements using
+   LESS given auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) {
+	ASSERT (h != NULL);
+	ASSERT (less != NULL);
+
+	h->root = NULL;
+	h->size = 0;
+	h->less = less;
+	h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_push (struct heap *h, struct heap_elem *e) {
+	ASSERT (h != NULL);
+	ASSERT (e != NULL);
+
+	e->child = e->next = e->prev = NULL;
+	h->root = h->root != NULL ? link (h, h->root, e) : e;
+	h->size++;
+}
+
+/* Removes and returns the greatest element in H, which must not
+   be empty.  If more than one element is greatest, returns an
+   arbitrary one of them. */
+struct heap_elem *
+heap_pop (struct heap *h) {
+	struct heap_elem *top;
+
+	ASSERT (h != NULL);
+	ASSERT (h->root != NULL);
+
+	top = h->root;
+	h->root = merge_pairs (h, top->child);
+	top->child = NULL;
+	h->size--;
+	return top;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) {
+	struct heap_elem *sub;
+
+	ASSERT (h != NULL);
+	ASSERT (e != NULL);
+
+	if (e == h->root) {
+		heap_pop (h);
+		return;
+	}
+
+	detach (e);
+	sub = merge_pairs (h, e->child);
+	e->child = NULL;
+	if (sub != NULL)
+		h->root = link (h, h->root, sub);
+	h->size--;
+}
+
+/* Restores the heap order of H after the value of E, which must
+   be in H, has increased or stayed the same.  Takes constant
+   time. */
+void
+heap_increase (struct heap *h, struct heap_elem *e) {
+	ASSERT (h != NULL);
+	ASSERT (e != NULL);
+
+	if (e == h->root)
+		return;
+
+	/* E is still no less than its own children, so its whole
+	   subtree can be cut out and linked back in at the root. */
+	detach (e);
+	h->root = link (h, h->root, e);
+}
+
+/* Restores the heap order of H after the value of E, which must
+   be in H, has changed in either direction. */
+void
+heap_update (struct heap *h, struct heap_elem *e) {
+	heap_remove (h, e);
+	heap_push (h, e);
+}
+
+/* Returns the greatest element in H, which must not be empty.
+   If more than one element is greatest, returns an arbitrary one
+   of them. */
+struct heap_elem *
+heap_top (struct heap *h) {
+	ASSERT (h != NULL);
+	ASSERT (h->root != NULL);
+
+	return h->root;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (struct heap *h) {
+	return h->size;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (struct heap *h) {
+	return h->root == NULL;
+}
+
+/* Links the trees rooted at A and B, which must have no
+   siblings, by making the lesser root the leftmost child of the
+   greater.  Returns the root of the combined tree.  When A and B
+   are equal, A stays on top. */
+static struct heap_elem *
+link (struct heap *h, struct heap_elem *a, struct heap_elem *b) {
+	struct heap_elem *t;
+
+	if (h->less (a, b, h->aux)) {
+		t = a;
+		a = b;
+		b = t;
+	}
+
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	a->next = a->prev = NULL;
+	return a;
+}
+
+/* Combines the sibling trees starting at FIRST into a single
+   tree and returns its root, or a null pointer if FIRST is
+   null.  Siblings are linked in pairs from left to right, then
+   the pairs are linked together from right to left. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass.  PAIRS collects the linked pairs, chained
+	   through `next' with the rightmost pair first. */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+
+		first = b != NULL ? b->next : NULL;
+		a->next = a->prev = NULL;
+		if (b != NULL) {
+			b->next = b->prev = NULL;
+			a = link (h, a, b);
+		}
+		a->next = pairs;
+		pairs = a;
+	}
+
+	/* Second pass. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+
+		pairs->next = NULL;
+		root = root != NULL ? link (h, root, pairs) : pairs;
+		pairs = next;
+	}
+	return root;
+}
+
+/* Unlinks E, which must not be a root, from its parent and
+   siblings.  E keeps its children. */
+static void
+detach (struct heap_elem *e) {
+	ASSERT (e->prev != NULL);
+
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	e->next = e->prev = NULL;
+}
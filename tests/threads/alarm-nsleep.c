@@ -0,0 +1,82 @@
+/* Checks the TSC clock and sub-tick sleeps.
+
+   Sleeps of 50 microseconds must take at least that long by
+   timer_now(), but must be ended by a one-shot countdown instead
+   of waiting for the next tick, both while the CPU is idle and
+   while a lower-priority thread keeps it busy.  Finally, a thread
+   that spins for a number of ticks must be charged that much TSC
+   time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEP_CNT 20
+#define SLEEP_US 50
+
+static void check_usleep (const char *when);
+static thread_func spin_func;
+
+void
+test_alarm_nsleep (void)
+{
+  volatile bool done = false;
+  uint64_t cycles;
+  int64_t start, ns;
+
+  check_usleep ("idle");
+
+  thread_create ("spinner", PRI_DEFAULT - 1, spin_func, (void *) &done);
+  check_usleep ("busy");
+  done = true;
+
+  /* Spin for 10 ticks.  Yielding charges the run so far. */
+  timer_sleep (1);
+  thread_yield ();
+  cycles = thread_current ()->cpu_cycles;
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 10)
+    continue;
+  thread_yield ();
+  ns = timer_tsc_to_ns (thread_current ()->cpu_cycles - cycles);
+  if (ns < 9 * NSEC_PER_TICK || ns > 11 * NSEC_PER_TICK)
+    fail ("10 ticks of spinning were charged as %lld us", ns / 1000);
+  msg ("10 ticks of spinning were charged as 10 ticks.");
+}
+
+/* Sleeps SLEEP_CNT times for SLEEP_US microseconds each, and
+   checks how long the sleeps took.  Waiting for a timer tick
+   each time would take about SLEEP_CNT / 2 ticks. */
+static void
+check_usleep (const char *when)
+{
+  int64_t start = timer_now ();
+  int i;
+
+  for (i = 0; i < SLEEP_CNT; i++)
+    {
+      int64_t before = timer_now ();
+      int64_t ns;
+
+      timer_usleep (SLEEP_US);
+      ns = timer_now () - before;
+      if (ns < SLEEP_US * 1000)
+        fail ("%d us sleep ended after %lld ns", SLEEP_US, ns);
+    }
+  if (timer_now () - start >= 4 * NSEC_PER_TICK)
+    fail ("%d sleeps of %d us took %lld us while %s", SLEEP_CNT, SLEEP_US,
+          (timer_now () - start) / 1000, when);
+  msg ("%d sleeps of %d us took less than 4 ticks while %s.",
+       SLEEP_CNT, SLEEP_US, when);
+}
+
+static void
+spin_func (void *done_)
+{
+  volatile bool *done = done_;
+
+  while (!*done)
+    continue;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-nsleep) begin
+(alarm-nsleep) 20 sleeps of 50 us took less than 4 ticks while idle.
+(alarm-nsleep) 20 sleeps of 50 us took less than 4 ticks while busy.
+(alarm-nsleep) 10 ticks of spinning were charged as 10 ticks.
+(alarm-nsleep) end
+EOF
+pass;
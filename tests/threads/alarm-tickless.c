@@ -0,0 +1,70 @@
+/* Runs with -tickless, so that the timer stops ticking whenever
+   only the idle thread is left to run.  Sleeps for various
+   numbers of ticks, some longer than a single one-shot countdown
+   can cover, and checks that each sleep ends on the right tick
+   and that the tick count keeps up with the TSC clock across the
+   ticks that were skipped. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void check_sleep (int64_t ticks);
+static thread_func helper_func;
+
+void
+test_alarm_tickless (void)
+{
+  static const int durations[] = {1, 2, 5, 13, 100};
+  int64_t start;
+  int64_t helper_woke = -1;
+  size_t i;
+
+  ASSERT (timer_tickless);
+
+  /* Make sure we're at the beginning of a timer tick. */
+  timer_sleep (1);
+
+  for (i = 0; i < sizeof durations / sizeof *durations; i++)
+    check_sleep (durations[i]);
+
+  /* Another sleeper with an earlier wakeup must cut the idle
+     countdown short. */
+  start = timer_ticks ();
+  thread_create ("helper", PRI_DEFAULT + 1, helper_func, &helper_woke);
+  timer_sleep (start + 60 - timer_ticks ());
+  msg ("helper woke up after %d ticks", (int) (helper_woke - start));
+  msg ("main woke up after %d ticks", (int) timer_elapsed (start));
+}
+
+/* Sleeps for TICKS ticks and checks when it woke up, by the tick
+   count and by the clock. */
+static void
+check_sleep (int64_t ticks)
+{
+  int64_t start = timer_ticks ();
+  int64_t start_ns = timer_now ();
+  int64_t slack = 1 + ticks / 20;
+  int64_t elapsed, elapsed_ns;
+
+  timer_sleep (ticks);
+  elapsed = timer_elapsed (start);
+  elapsed_ns = timer_now () - start_ns;
+
+  msg ("sleep %d: woke up after %d ticks", (int) ticks, (int) elapsed);
+  if (elapsed_ns < (ticks - slack) * NSEC_PER_TICK
+      || elapsed_ns > (ticks + slack) * NSEC_PER_TICK)
+    fail ("sleep %d took %lld us by the clock", (int) ticks,
+          elapsed_ns / 1000);
+}
+
+static void
+helper_func (void *woke_)
+{
+  int64_t *woke = woke_;
+
+  timer_sleep (37);
+  *woke = timer_ticks ();
+}
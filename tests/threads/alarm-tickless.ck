@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-tickless) begin
+(alarm-tickless) sleep 1: woke up after 1 ticks
+(alarm-tickless) sleep 2: woke up after 2 ticks
+(alarm-tickless) sleep 5: woke up after 5 ticks
+(alarm-tickless) sleep 13: woke up after 13 ticks
+(alarm-tickless) sleep 100: woke up after 100 ticks
+(alarm-tickless) helper woke up after 37 ticks
+(alarm-tickless) main woke up after 60 ticks
+(alarm-tickless) end
+EOF
+pass;
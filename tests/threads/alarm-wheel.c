@@ -0,0 +1,82 @@
+/* Creates threads that sleep until wakeup times that fall into
+   the same timer wheel slot, or wrap around the wheel more than
+   once, and checks that each of them wakes up on exactly the tick
+   it asked for, in order of wakeup time. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+
+/* Sleep durations, in ticks after the common start.  10, 74, 138
+   and 202 differ by a multiple of 64, the number of wheel
+   slots. */
+static const int durations[THREAD_CNT] = {138, 10, 74, 11, 202, 75, 1, 65};
+
+/* Information about the test. */
+struct wheel_test
+  {
+    int64_t start;              /* Tick at which all threads start sleeping. */
+    int *output_pos;            /* Current position in output buffer. */
+    int output[THREAD_CNT * 2]; /* Thread IDs and wakeup ticks. */
+  };
+
+struct wheel_thread
+  {
+    struct wheel_test *test;    /* Info shared between all threads. */
+    int id;                     /* Index into durations[]. */
+  };
+
+static thread_func wheel_sleeper;
+
+void
+test_alarm_wheel (void)
+{
+  struct wheel_test test;
+  struct wheel_thread threads[THREAD_CNT];
+  int *op;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  test.start = timer_ticks () + 10;
+  test.output_pos = test.output;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      threads[i].test = &test;
+      threads[i].id = i;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT + 1, wheel_sleeper, &threads[i]);
+    }
+
+  /* Wait long enough for all the threads to finish. */
+  timer_sleep (10 + 202 + 50);
+
+  if (test.output_pos != test.output + THREAD_CNT * 2)
+    fail ("only %d threads woke up", (int) (test.output_pos - test.output) / 2);
+  for (op = test.output; op < test.output_pos; op += 2)
+    msg ("thread %d: duration=%d, woke up after %d ticks",
+         op[0], durations[op[0]], op[1]);
+}
+
+/* Sleeper thread. */
+static void
+wheel_sleeper (void *thread_)
+{
+  struct wheel_thread *t = thread_;
+  struct wheel_test *test = t->test;
+
+  timer_sleep (test->start + durations[t->id] - timer_ticks ());
+
+  /* Higher priority than the main thread, so nothing runs between
+     waking up and recording the time. */
+  *test->output_pos++ = t->id;
+  *test->output_pos++ = timer_ticks () - test->start;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-wheel) begin
+(alarm-wheel) thread 6: duration=1, woke up after 1 ticks
+(alarm-wheel) thread 1: duration=10, woke up after 10 ticks
+(alarm-wheel) thread 3: duration=11, woke up after 11 ticks
+(alarm-wheel) thread 7: duration=65, woke up after 65 ticks
+(alarm-wheel) thread 2: duration=74, woke up after 74 ticks
+(alarm-wheel) thread 5: duration=75, woke up after 75 ticks
+(alarm-wheel) thread 0: duration=138, woke up after 138 ticks
+(alarm-wheel) thread 4: duration=202, woke up after 202 ticks
+(alarm-wheel) end
+EOF
+pass;
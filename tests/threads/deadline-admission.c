@@ -0,0 +1,86 @@
+/* Checks admission control for the deadline class.  Reservations
+   are admitted only while the total bandwidth of all deadline
+   threads stays within 95%, changing a thread's own reservation
+   counts only the difference, and bandwidth is given back when a
+   thread leaves the class or exits. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Period of every reservation, in ns. */
+#define PERIOD 100000000
+
+struct reserve_data
+  {
+    int percent;                /* Bandwidth to ask for. */
+    struct semaphore *done;     /* Upped after asking. */
+    struct semaphore *hold;     /* If nonnull, downed before exiting. */
+  };
+
+static void reserve (const char *name, int percent);
+static void spawn (const char *name, int percent, struct semaphore *done,
+                   struct semaphore *hold);
+static thread_func reserve_thread_func;
+
+void
+test_deadline_admission (void)
+{
+  struct semaphore done, hold;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  sema_init (&hold, 0);
+
+  reserve ("main", 60);
+  spawn ("thread A", 40, &done, NULL);
+  spawn ("thread B", 30, &done, &hold);
+  reserve ("main", 70);
+  reserve ("main", 0);
+  spawn ("thread C", 60, &done, NULL);
+  sema_up (&hold);
+  reserve ("main", 95);
+  reserve ("main", 0);
+}
+
+/* Asks for PERCENT of the CPU for the running thread, which is
+   named NAME, and reports the outcome. */
+static void
+reserve (const char *name, int percent)
+{
+  bool ok = thread_set_deadline ((int64_t) PERIOD * percent / 100, PERIOD);
+
+  msg ("%s: %d%% reservation %s.", name, percent,
+       ok ? "admitted" : "rejected");
+}
+
+/* Creates a thread named NAME that asks for PERCENT of the CPU,
+   and waits until it has. */
+static void
+spawn (const char *name, int percent, struct semaphore *done,
+       struct semaphore *hold)
+{
+  struct reserve_data data;
+
+  data.percent = percent;
+  data.done = done;
+  data.hold = hold;
+  thread_create (name, PRI_DEFAULT, reserve_thread_func, &data);
+  sema_down (done);
+}
+
+static void
+reserve_thread_func (void *data_)
+{
+  struct reserve_data *data = data_;
+  struct semaphore *hold = data->hold;
+
+  reserve (thread_name (), data->percent);
+  sema_up (data->done);
+  if (hold != NULL)
+    sema_down (hold);
+}
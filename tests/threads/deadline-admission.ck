@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(deadline-admission) begin
+(deadline-admission) main: 60% reservation admitted.
+(deadline-admission) thread A: 40% reservation rejected.
+(deadline-admission) thread B: 30% reservation admitted.
+(deadline-admission) main: 70% reservation rejected.
+(deadline-admission) main: 0% reservation admitted.
+(deadline-admission) thread C: 60% reservation admitted.
+(deadline-admission) main: 95% reservation admitted.
+(deadline-admission) main: 0% reservation admitted.
+(deadline-admission) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Creates a deadline thread that reserves 20 ms of every 100 ms
+   and then tries to use the CPU for 500 ms straight.  Once it
+   exhausts its budget it must be throttled until its deadline and
+   then replenished, so it ends up with about 100 ms of CPU time
+   and still finishes. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define RUNTIME 20000000
+#define PERIOD 100000000
+#define SPIN_TIME 500000000
+
+static thread_func cbs_thread_func;
+
+void
+test_deadline_cbs (void)
+{
+  struct semaphore done;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  thread_create ("cbs", PRI_DEFAULT, cbs_thread_func, &done);
+  sema_down (&done);
+}
+
+static void
+cbs_thread_func (void *done_)
+{
+  struct semaphore *done = done_;
+  uint64_t cycles;
+  int64_t start, ns;
+
+  if (!thread_set_deadline (RUNTIME, PERIOD))
+    fail ("reservation rejected");
+
+  /* Yielding charges the run so far. */
+  thread_yield ();
+  cycles = thread_current ()->cpu_cycles;
+  start = timer_now ();
+  while (timer_now () - start < SPIN_TIME)
+    continue;
+  thread_yield ();
+  ns = timer_tsc_to_ns (thread_current ()->cpu_cycles - cycles);
+
+  if (ns < 60000000 || ns > 160000000)
+    fail ("got %lld ms of CPU time in %d ms", ns / 1000000,
+          SPIN_TIME / 1000000);
+  msg ("got between 60 and 160 ms of CPU time in %d ms.",
+       SPIN_TIME / 1000000);
+
+  thread_set_deadline (0, 0);
+  sema_up (done);
+}
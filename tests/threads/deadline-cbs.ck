@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(deadline-cbs) begin
+(deadline-cbs) got between 60 and 160 ms of CPU time in 500 ms.
+(deadline-cbs) end
+EOF
+pass;
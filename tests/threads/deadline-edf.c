@@ -0,0 +1,75 @@
+/* Creates three deadline threads with different periods, in an
+   order that is neither ascending nor descending by period.
+   They all sleep until the same tick, so they wake up together
+   in the order they went to sleep, and each gets a new deadline
+   one period after waking.  They must then run earliest deadline
+   first, that is, in ascending order of period. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 3
+
+/* Periods, in ms. */
+static const int periods[THREAD_CNT] = {300, 100, 200};
+
+struct edf_test
+  {
+    int64_t wakeup;             /* Tick at which all threads wake up. */
+    int *output_pos;            /* Current position in output buffer. */
+  };
+
+struct edf_thread
+  {
+    struct edf_test *test;      /* Info shared between all threads. */
+    int id;                     /* Index into periods[]. */
+  };
+
+static thread_func edf_thread_func;
+
+void
+test_deadline_edf (void)
+{
+  struct edf_test test;
+  struct edf_thread threads[THREAD_CNT];
+  int output[THREAD_CNT];
+  int *op;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  test.wakeup = timer_ticks () + 10;
+  test.output_pos = output;
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      threads[i].test = &test;
+      threads[i].id = i;
+      snprintf (name, sizeof name, "period %d", periods[i]);
+      thread_create (name, PRI_DEFAULT + 1, edf_thread_func, &threads[i]);
+    }
+
+  /* Wait long enough for all the threads to finish. */
+  timer_sleep (20);
+
+  for (op = output; op < test.output_pos; op++)
+    msg ("thread with period %d ms ran.", periods[*op]);
+}
+
+static void
+edf_thread_func (void *thread_)
+{
+  struct edf_thread *t = thread_;
+  struct edf_test *test = t->test;
+  int64_t period = (int64_t) periods[t->id] * 1000000;
+
+  if (!thread_set_deadline (period / 100, period))
+    fail ("%s: reservation rejected", thread_name ());
+  timer_sleep (test->wakeup - timer_ticks ());
+  *test->output_pos++ = t->id;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(deadline-edf) begin
+(deadline-edf) thread with period 100 ms ran.
+(deadline-edf) thread with period 200 ms ran.
+(deadline-edf) thread with period 300 ms ran.
+(deadline-edf) end
+EOF
+pass;
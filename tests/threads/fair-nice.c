@@ -0,0 +1,84 @@
+/* Runs with -fair.  Two threads spin side by side for 2 seconds,
+   first both at nice 0, then at nice 0 and nice 5.  The CPU time
+   each is charged must follow their weights: an even split in the
+   first case, and about 1024:335, or 75% to 25%, in the
+   second. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPIN_TICKS (2 * TIMER_FREQ)
+
+struct spinner
+  {
+    int nice;                   /* Nice value to spin at. */
+    int64_t start;              /* Tick at which to start spinning. */
+    int64_t ns;                 /* CPU time charged while spinning. */
+  };
+
+static void check_split (int nice0, int nice1, int min_pct, int max_pct);
+static thread_func spin_func;
+
+void
+test_fair_nice (void)
+{
+  ASSERT (thread_fair);
+
+  check_split (0, 0, 40, 60);
+  check_split (0, 5, 65, 85);
+}
+
+/* Spins two threads at NICE0 and NICE1 and checks that the first
+   gets between MIN_PCT and MAX_PCT percent of their CPU time. */
+static void
+check_split (int nice0, int nice1, int min_pct, int max_pct)
+{
+  struct spinner spinners[2];
+  int64_t start = timer_ticks () + 10;
+  int pct;
+  int i;
+
+  spinners[0].nice = nice0;
+  spinners[1].nice = nice1;
+  for (i = 0; i < 2; i++)
+    {
+      char name[16];
+
+      spinners[i].start = start;
+      spinners[i].ns = 0;
+      snprintf (name, sizeof name, "nice %d", spinners[i].nice);
+      thread_create (name, PRI_DEFAULT, spin_func, &spinners[i]);
+    }
+
+  /* Wait long enough for both threads to finish. */
+  timer_sleep (start + SPIN_TICKS + 20 - timer_ticks ());
+
+  if (spinners[0].ns == 0 || spinners[1].ns == 0)
+    fail ("a spinner did not finish");
+  pct = spinners[0].ns * 100 / (spinners[0].ns + spinners[1].ns);
+  if (pct < min_pct || pct > max_pct)
+    fail ("nice %d got %d%% of the CPU against nice %d", nice0, pct, nice1);
+  msg ("nice %d got between %d%% and %d%% of the CPU against nice %d.",
+       nice0, min_pct, max_pct, nice1);
+}
+
+static void
+spin_func (void *spinner_)
+{
+  struct spinner *s = spinner_;
+  uint64_t cycles;
+
+  thread_set_nice (s->nice);
+  timer_sleep (s->start - timer_ticks ());
+
+  /* Yielding charges the run so far. */
+  thread_yield ();
+  cycles = thread_current ()->cpu_cycles;
+  while (timer_ticks () < s->start + SPIN_TICKS)
+    continue;
+  thread_yield ();
+  s->ns = timer_tsc_to_ns (thread_current ()->cpu_cycles - cycles);
+}
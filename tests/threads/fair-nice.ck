@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fair-nice) begin
+(fair-nice) nice 0 got between 40% and 60% of the CPU against nice 0.
+(fair-nice) nice 0 got between 65% and 85% of the CPU against nice 5.
+(fair-nice) end
+EOF
+pass;
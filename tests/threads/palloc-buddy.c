@@ -0,0 +1,85 @@
+/* Checks that the page allocator merges freed blocks with their
+   buddies.  Takes every free page of the kernel pool one at a
+   time, which splits all of its blocks down to single pages, and
+   frees them again in an interleaved order, so that most pages
+   are freed while their buddy is still in use.  Afterward, the
+   largest block the pool can hand out must be as large as it was
+   before. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+
+static size_t largest_block (void);
+
+void
+test_palloc_buddy (void)
+{
+  void **pages, **page, **next, **kept;
+  size_t page_cnt, before, after, i;
+
+  /* The first failed request empties the pool's zero stash, so
+     only the second measurement is stable. */
+  largest_block ();
+  before = largest_block ();
+
+  /* Take every free page.  Page I holds the address of page
+     I - 1, so the list needs no memory of its own. */
+  pages = NULL;
+  for (page_cnt = 0; ; page_cnt++)
+    {
+      page = palloc_get_page (0);
+      if (page == NULL)
+        break;
+      *page = pages;
+      pages = page;
+    }
+  if (page_cnt < before)
+    fail ("only %zu pages free, expected at least %zu", page_cnt, before);
+  msg ("Took every free page.");
+
+  /* Free every other page, then the rest. */
+  kept = NULL;
+  for (page = pages, i = 0; page != NULL; page = next, i++)
+    {
+      next = *page;
+      if (i % 2 == 0)
+        palloc_free_page (page);
+      else
+        {
+          *page = kept;
+          kept = page;
+        }
+    }
+  for (page = kept; page != NULL; page = next)
+    {
+      next = *page;
+      palloc_free_page (page);
+    }
+  msg ("Freed them all again.");
+
+  after = largest_block ();
+  if (after != before)
+    fail ("largest block was %zu pages, now %zu", before, after);
+  msg ("Largest free block is as large as before.");
+}
+
+/* Returns the number of pages in the largest power-of-two block
+   that the kernel pool can allocate. */
+static size_t
+largest_block (void)
+{
+  size_t cnt;
+
+  for (cnt = (size_t) 1 << 18; cnt > 0; cnt /= 2)
+    {
+      void *block = palloc_get_multiple (0, cnt);
+      if (block != NULL)
+        {
+          palloc_free_multiple (block, cnt);
+          return cnt;
+        }
+    }
+  return 0;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Took every free page.
+(palloc-buddy) Freed them all again.
+(palloc-buddy) Largest free block is as large as before.
+(palloc-buddy) end
+EOF
+pass;
@@ -0,0 +1,82 @@
+/* The main thread sets its priority to PRI_MIN and acquires
+   lock 0.  It then creates threads 1 through 15, with priorities
+   PRI_MIN + 2, 4, ..., 30, where thread i acquires lock i and
+   then blocks on lock i - 1, so that they form a chain of 15
+   donations ending at the main thread.
+
+   Finally a thread at PRI_MAX blocks on lock 15, at the far end
+   of the chain.  Its priority must be passed down all 16 links
+   to the main thread.  When the main thread releases lock 0, the
+   chain unwinds from the front, every thread briefly running at
+   PRI_MAX, and then each thread finishes at its own priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define CHAIN_LENGTH 16
+
+struct lock_pair
+  {
+    struct lock *own;           /* Lock to hold, or null. */
+    struct lock *wait;          /* Lock to wait for. */
+  };
+
+static thread_func chain_thread_func;
+
+void
+test_priority_donate_deep (void)
+{
+  struct lock locks[CHAIN_LENGTH];
+  struct lock_pair lock_pairs[CHAIN_LENGTH + 1];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+
+  for (i = 0; i < CHAIN_LENGTH; i++)
+    lock_init (&locks[i]);
+  lock_acquire (&locks[0]);
+
+  for (i = 1; i < CHAIN_LENGTH; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "thread %d", i);
+      lock_pairs[i].own = &locks[i];
+      lock_pairs[i].wait = &locks[i - 1];
+      thread_create (name, PRI_MIN + i * 2, chain_thread_func, &lock_pairs[i]);
+    }
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_MIN + (CHAIN_LENGTH - 1) * 2, thread_get_priority ());
+
+  lock_pairs[CHAIN_LENGTH].own = NULL;
+  lock_pairs[CHAIN_LENGTH].wait = &locks[CHAIN_LENGTH - 1];
+  thread_create ("top", PRI_MAX, chain_thread_func,
+                 &lock_pairs[CHAIN_LENGTH]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_MAX, thread_get_priority ());
+
+  lock_release (&locks[0]);
+  msg ("Main thread finishing with priority %d.", thread_get_priority ());
+}
+
+static void
+chain_thread_func (void *lock_pair_)
+{
+  struct lock_pair *lock_pair = lock_pair_;
+
+  if (lock_pair->own != NULL)
+    lock_acquire (lock_pair->own);
+  lock_acquire (lock_pair->wait);
+  msg ("%s got lock with priority %d.", thread_name (), thread_get_priority ());
+  lock_release (lock_pair->wait);
+
+  if (lock_pair->own != NULL)
+    lock_release (lock_pair->own);
+  msg ("%s finishing with priority %d.", thread_name (), thread_get_priority ());
+}
@@ -0,0 +1,44 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-deep) begin
+(priority-donate-deep) Main thread should have priority 30.  Actual priority: 30.
+(priority-donate-deep) Main thread should have priority 63.  Actual priority: 63.
+(priority-donate-deep) thread 1 got lock with priority 63.
+(priority-donate-deep) thread 2 got lock with priority 63.
+(priority-donate-deep) thread 3 got lock with priority 63.
+(priority-donate-deep) thread 4 got lock with priority 63.
+(priority-donate-deep) thread 5 got lock with priority 63.
+(priority-donate-deep) thread 6 got lock with priority 63.
+(priority-donate-deep) thread 7 got lock with priority 63.
+(priority-donate-deep) thread 8 got lock with priority 63.
+(priority-donate-deep) thread 9 got lock with priority 63.
+(priority-donate-deep) thread 10 got lock with priority 63.
+(priority-donate-deep) thread 11 got lock with priority 63.
+(priority-donate-deep) thread 12 got lock with priority 63.
+(priority-donate-deep) thread 13 got lock with priority 63.
+(priority-donate-deep) thread 14 got lock with priority 63.
+(priority-donate-deep) thread 15 got lock with priority 63.
+(priority-donate-deep) top got lock with priority 63.
+(priority-donate-deep) top finishing with priority 63.
+(priority-donate-deep) thread 15 finishing with priority 30.
+(priority-donate-deep) thread 14 finishing with priority 28.
+(priority-donate-deep) thread 13 finishing with priority 26.
+(priority-donate-deep) thread 12 finishing with priority 24.
+(priority-donate-deep) thread 11 finishing with priority 22.
+(priority-donate-deep) thread 10 finishing with priority 20.
+(priority-donate-deep) thread 9 finishing with priority 18.
+(priority-donate-deep) thread 8 finishing with priority 16.
+(priority-donate-deep) thread 7 finishing with priority 14.
+(priority-donate-deep) thread 6 finishing with priority 12.
+(priority-donate-deep) thread 5 finishing with priority 10.
+(priority-donate-deep) thread 4 finishing with priority 8.
+(priority-donate-deep) thread 3 finishing with priority 6.
+(priority-donate-deep) thread 2 finishing with priority 4.
+(priority-donate-deep) thread 1 finishing with priority 2.
+(priority-donate-deep) Main thread finishing with priority 0.
+(priority-donate-deep) end
+EOF
+pass;
@@ -0,0 +1,81 @@
+/* The main thread acquires six locks.  Then it creates six
+   threads, in ascending order of priority, that each block on
+   a different one of the locks, so that the lock with the
+   highest waiter is neither the first nor the last acquired.
+
+   The main thread then releases the locks in the order it
+   acquired them.  After each release its priority must be the
+   highest priority still waiting for a lock it holds, and
+   exactly the waiters above that priority must have run. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define LOCK_CNT 6
+
+/* Priority of the thread that waits for each lock. */
+static const int waiter_priority[LOCK_CNT] = {40, 35, 50, 33, 45, 38};
+
+/* Lock that each thread waits for, in order of creation. */
+static const int creation_order[LOCK_CNT] = {3, 1, 5, 0, 4, 2};
+
+static thread_func waiter_thread_func;
+
+void
+test_priority_donate_heap (void)
+{
+  struct lock locks[LOCK_CNT];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      lock_init (&locks[i]);
+      lock_acquire (&locks[i]);
+    }
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      int lock_idx = creation_order[i];
+      char name[16];
+
+      snprintf (name, sizeof name, "lock %d", lock_idx);
+      thread_create (name, waiter_priority[lock_idx], waiter_thread_func,
+                     &locks[lock_idx]);
+      msg ("Main thread should have priority %d.  Actual priority: %d.",
+           waiter_priority[lock_idx], thread_get_priority ());
+    }
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      int expected = PRI_DEFAULT;
+      int j;
+
+      for (j = i + 1; j < LOCK_CNT; j++)
+        if (waiter_priority[j] > expected)
+          expected = waiter_priority[j];
+
+      lock_release (&locks[i]);
+      msg ("Released lock %d.  Main thread should have priority %d.  "
+           "Actual priority: %d.", i, expected, thread_get_priority ());
+    }
+}
+
+static void
+waiter_thread_func (void *lock_)
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  msg ("Thread %s (priority %d) acquired its lock.",
+       thread_name (), thread_get_priority ());
+  lock_release (lock);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-heap) begin
+(priority-donate-heap) Main thread should have priority 33.  Actual priority: 33.
+(priority-donate-heap) Main thread should have priority 35.  Actual priority: 35.
+(priority-donate-heap) Main thread should have priority 38.  Actual priority: 38.
+(priority-donate-heap) Main thread should have priority 40.  Actual priority: 40.
+(priority-donate-heap) Main thread should have priority 45.  Actual priority: 45.
+(priority-donate-heap) Main thread should have priority 50.  Actual priority: 50.
+(priority-donate-heap) Released lock 0.  Main thread should have priority 50.  Actual priority: 50.
+(priority-donate-heap) Released lock 1.  Main thread should have priority 50.  Actual priority: 50.
+(priority-donate-heap) Thread lock 2 (priority 50) acquired its lock.
+(priority-donate-heap) Released lock 2.  Main thread should have priority 45.  Actual priority: 45.
+(priority-donate-heap) Released lock 3.  Main thread should have priority 45.  Actual priority: 45.
+(priority-donate-heap) Thread lock 4 (priority 45) acquired its lock.
+(priority-donate-heap) Thread lock 0 (priority 40) acquired its lock.
+(priority-donate-heap) Released lock 4.  Main thread should have priority 38.  Actual priority: 38.
+(priority-donate-heap) Thread lock 5 (priority 38) acquired its lock.
+(priority-donate-heap) Thread lock 1 (priority 35) acquired its lock.
+(priority-donate-heap) Thread lock 3 (priority 33) acquired its lock.
+(priority-donate-heap) Released lock 5.  Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-heap) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Creates two threads at each of several priorities spread over
+   the whole range, in no particular order, while the main thread
+   runs at PRI_MAX so that none of them can run yet.  When the
+   main thread drops to PRI_MIN, they must run highest priority
+   first, and in creation order among threads of equal
+   priority. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 16
+
+static const int priorities[THREAD_CNT] =
+  {17, 62, 1, 40, 31, 9, 48, 55, 62, 1, 17, 55, 9, 31, 48, 40};
+
+struct runqueue_data
+  {
+    int id;                     /* Creation order. */
+    int **op;                   /* Output buffer position. */
+  };
+
+static thread_func runqueue_thread_func;
+
+void
+test_priority_runqueue (void)
+{
+  struct runqueue_data data[THREAD_CNT];
+  int output[THREAD_CNT];
+  int *op;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MAX);
+  op = output;
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      data[i].id = i;
+      data[i].op = &op;
+      snprintf (name, sizeof name, "%d", i);
+      thread_create (name, priorities[i], runqueue_thread_func, &data[i]);
+    }
+
+  /* Every thread runs to completion before this returns. */
+  thread_set_priority (PRI_MIN);
+
+  if (op - output != THREAD_CNT)
+    fail ("%d threads ran, expected %d", (int) (op - output), THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    msg ("thread %d, priority %d", output[i], priorities[output[i]]);
+}
+
+static void
+runqueue_thread_func (void *data_)
+{
+  struct runqueue_data *data = data_;
+
+  *(*data->op)++ = data->id;
+}
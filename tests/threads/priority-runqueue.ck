@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-runqueue) begin
+(priority-runqueue) thread 1, priority 62
+(priority-runqueue) thread 8, priority 62
+(priority-runqueue) thread 7, priority 55
+(priority-runqueue) thread 11, priority 55
+(priority-runqueue) thread 6, priority 48
+(priority-runqueue) thread 14, priority 48
+(priority-runqueue) thread 3, priority 40
+(priority-runqueue) thread 15, priority 40
+(priority-runqueue) thread 4, priority 31
+(priority-runqueue) thread 13, priority 31
+(priority-runqueue) thread 0, priority 17
+(priority-runqueue) thread 10, priority 17
+(priority-runqueue) thread 5, priority 9
+(priority-runqueue) thread 12, priority 9
+(priority-runqueue) thread 2, priority 1
+(priority-runqueue) thread 9, priority 1
+(priority-runqueue) end
+EOF
+pass;
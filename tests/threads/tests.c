@@ -17,6 +17,14 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-wheel", test_alarm_wheel},
+    {"alarm-tickless", test_alarm_tickless},
+    {"alarm-nsleep", test_alarm_nsleep},
+    {"deadline-admission", test_deadline_admission},
+    {"deadline-edf", test_deadline_edf},
+    {"deadline-cbs", test_deadline_cbs},
+    {"fair-nice", test_fair_nice},
+    {"palloc-buddy", test_palloc_buddy},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,10 +33,13 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-heap", test_priority_donate_heap},
+    {"priority-donate-deep", test_priority_donate_deep},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-runqueue", test_priority_runqueue},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -11,6 +11,14 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_wheel;
+extern test_func test_alarm_tickless;
+extern test_func test_alarm_nsleep;
+extern test_func test_deadline_admission;
+extern test_func test_deadline_edf;
+extern test_func test_deadline_cbs;
+extern test_func test_fair_nice;
+extern test_func test_palloc_buddy;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,10 +27,13 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_heap;
+extern test_func test_priority_donate_deep;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_runqueue;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
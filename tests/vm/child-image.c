@@ -0,0 +1,36 @@
+/* Child process of image-share.
+   Checks a few pages of read-only data that every process running
+   this executable shares, then writes to a data page that no other
+   process may see. */
+
+#include <string.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-image";
+
+#define S16 "0123456789abcdef"
+#define S256 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16 S16
+#define S4K S256 S256 S256 S256 S256 S256 S256 S256 \
+            S256 S256 S256 S256 S256 S256 S256 S256
+
+/* Three pages and more of read-only data. */
+static const char pattern[] = S4K S4K S4K S4K;
+
+static char data[4096];
+
+int
+main (int argc, char *argv[])
+{
+  size_t i;
+
+  for (i = 0; i < sizeof pattern - 1; i++)
+    if (pattern[i] != S16[i % 16])
+      fail ("bad byte %zu in read-only data", i);
+
+  memset (data, argc, sizeof data);
+  for (i = 0; i < sizeof data; i++)
+    if (data[i] != argc)
+      fail ("bad byte %zu in data", i);
+  (void) argv;
+  return 0x42;
+}
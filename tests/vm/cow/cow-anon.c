@@ -0,0 +1,99 @@
+/* Checks copy-on-write fork for several anonymous pages.  The child
+ * must start out sharing every frame with its parent and get a copy
+ * of a page only when it writes to it, whether from user code or
+ * through read().  The parent's data must stay untouched, and once
+ * the child has exited, the parent must be able to write to its
+ * pages without copying them. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT 4
+
+static char pages[PAGE_COUNT][PAGE_SIZE];
+static void *pa_parent[PAGE_COUNT];
+
+/* Byte J of page I. */
+static char
+pattern (size_t i, size_t j)
+{
+	return (char) (i * 17 + j);
+}
+
+static bool
+page_is_intact (size_t i)
+{
+	size_t j;
+
+	for (j = 0; j < PAGE_SIZE; j++)
+		if (pages[i][j] != pattern (i, j))
+			return false;
+	return true;
+}
+
+static void
+child_main (void)
+{
+	size_t i;
+	int handle;
+
+	for (i = 0; i < PAGE_COUNT; i++)
+		if (get_phys_addr (pages[i]) != pa_parent[i])
+			fail ("page %zu is not shared after fork", i);
+	msg ("child shares every page");
+
+	pages[0][0] = '@';
+	CHECK (get_phys_addr (pages[0]) != pa_parent[0],
+	       "written page has its own frame");
+	for (i = 1; i < PAGE_COUNT; i++)
+		if (get_phys_addr (pages[i]) != pa_parent[i])
+			fail ("page %zu was copied without a write", i);
+	msg ("other pages are still shared");
+
+	CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+	CHECK (read (handle, pages[1], sizeof sample - 1) == sizeof sample - 1,
+	       "read \"sample.txt\" into a shared page");
+	close (handle);
+	CHECK (memcmp (pages[1], sample, sizeof sample - 1) == 0,
+	       "compare read data against written data");
+	CHECK (get_phys_addr (pages[1]) != pa_parent[1],
+	       "page written by read has its own frame");
+}
+
+void
+test_main (void)
+{
+	pid_t child;
+	size_t i, j;
+
+	for (i = 0; i < PAGE_COUNT; i++) {
+		for (j = 0; j < PAGE_SIZE; j++)
+			pages[i][j] = pattern (i, j);
+		pa_parent[i] = get_phys_addr (pages[i]);
+	}
+
+	child = fork ("child");
+	if (child == 0) {
+		child_main ();
+		return;
+	}
+	wait (child);
+
+	for (i = 0; i < PAGE_COUNT; i++)
+		if (!page_is_intact (i))
+			fail ("parent's page %zu changed", i);
+	msg ("parent's pages are intact");
+
+	for (i = 0; i < PAGE_COUNT; i++) {
+		pages[i][0] = '!';
+		if (get_phys_addr (pages[i]) != pa_parent[i])
+			fail ("page %zu was copied with no other sharer", i);
+	}
+	msg ("parent writes in place");
+}
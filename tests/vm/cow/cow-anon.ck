@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-anon) begin
+(cow-anon) child shares every page
+(cow-anon) written page has its own frame
+(cow-anon) other pages are still shared
+(cow-anon) open "sample.txt"
+(cow-anon) read "sample.txt" into a shared page
+(cow-anon) compare read data against written data
+(cow-anon) page written by read has its own frame
+(cow-anon) end
+(cow-anon) parent's pages are intact
+(cow-anon) parent writes in place
+(cow-anon) end
+EOF
+pass;
@@ -0,0 +1,33 @@
+/* Runs 2 child-image processes at once, so that they share the
+   read-only pages of the executable, then one more after they exit,
+   which finds those pages still cached. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 2
+
+static pid_t
+spawn (void)
+{
+  pid_t pid = fork ("child-image");
+  if (pid == 0) {
+    if (exec ("child-image") == -1)
+      fail ("failed to exec child-image");
+  }
+  return pid;
+}
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    children[i] = spawn ();
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (children[i]) == 0x42, "wait for child %d", i);
+  CHECK (wait (spawn ()) == 0x42, "wait for child %d", i);
+}
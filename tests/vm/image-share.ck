@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(image-share) begin
+(image-share) wait for child 0
+(image-share) wait for child 1
+(image-share) wait for child 2
+(image-share) end
+EOF
+pass;
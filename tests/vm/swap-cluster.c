@@ -0,0 +1,52 @@
+/* Fills an array several times larger than memory with data that
+ * does not compress, so that evicted pages have to go to the swap
+ * disk, then reads it back in order and checks it.  The .ck file
+ * checks that the pages went out several to a write and that
+ * reading them back was served partly by read-ahead. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT (16 * 256)
+#define WORDS_PER_PAGE (PAGE_SIZE / sizeof (uint64_t))
+
+static uint64_t pages[PAGE_COUNT][WORDS_PER_PAGE];
+
+/* Returns the next value of the xorshift generator in *STATE. */
+static uint64_t
+next_word (uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+void
+test_main (void)
+{
+	size_t i, j;
+
+	msg ("fill %d pages", PAGE_COUNT);
+	for (i = 0; i < PAGE_COUNT; i++) {
+		uint64_t state = i + 1;
+
+		for (j = 0; j < WORDS_PER_PAGE; j++)
+			pages[i][j] = next_word (&state);
+	}
+
+	msg ("check %d pages", PAGE_COUNT);
+	for (i = 0; i < PAGE_COUNT; i++) {
+		uint64_t state = i + 1;
+
+		for (j = 0; j < WORDS_PER_PAGE; j++)
+			if (pages[i][j] != next_word (&state))
+				fail ("page %zu is inconsistent", i);
+	}
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::swap_stats;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-cluster) begin
+(swap-cluster) fill 4096 pages
+(swap-cluster) check 4096 pages
+(swap-cluster) end
+EOF
+check_swap_clustering ();
+pass;
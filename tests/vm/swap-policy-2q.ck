@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::swap_stats;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-policy-2q) begin
+(swap-policy-2q) scan 0
+(swap-policy-2q) scan 1
+(swap-policy-2q) scan 2
+(swap-policy-2q) end
+EOF
+check_eviction_policy ("2q");
+pass;
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::swap_stats;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-policy-arc) begin
+(swap-policy-arc) scan 0
+(swap-policy-arc) scan 1
+(swap-policy-arc) scan 2
+(swap-policy-arc) end
+EOF
+check_eviction_policy ("arc");
+pass;
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::swap_stats;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-policy-clock) begin
+(swap-policy-clock) scan 0
+(swap-policy-clock) scan 1
+(swap-policy-clock) scan 2
+(swap-policy-clock) end
+EOF
+check_eviction_policy ("clock");
+pass;
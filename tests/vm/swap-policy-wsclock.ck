@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::swap_stats;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-policy-wsclock) begin
+(swap-policy-wsclock) scan 0
+(swap-policy-wsclock) scan 1
+(swap-policy-wsclock) scan 2
+(swap-policy-wsclock) end
+EOF
+check_eviction_policy ("wsclock");
+pass;
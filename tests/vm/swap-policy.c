@@ -0,0 +1,55 @@
+/* Keeps a small set of hot pages in use while it repeatedly scans
+ * a much larger array of cold pages that cannot all fit in memory,
+ * checking every page it touches.  The same program is run once
+ * under each page replacement policy. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 64
+#define COLD_PAGES (12 * 256)
+#define ROUNDS 3
+
+/* Cold pages between two passes over the hot pages. */
+#define HOT_INTERVAL 32
+
+static char hot[HOT_PAGES * PAGE_SIZE];
+static char cold[COLD_PAGES * PAGE_SIZE];
+
+static void
+touch_hot (void)
+{
+	size_t i;
+
+	for (i = 0; i < HOT_PAGES; i++)
+		if (hot[i * PAGE_SIZE] != (char) (i * 7 + 1))
+			fail ("hot page %zu is inconsistent", i);
+}
+
+void
+test_main (void)
+{
+	size_t i;
+	int round;
+
+	for (i = 0; i < HOT_PAGES; i++)
+		hot[i * PAGE_SIZE] = (char) (i * 7 + 1);
+
+	for (round = 0; round < ROUNDS; round++) {
+		msg ("scan %d", round);
+		for (i = 0; i < COLD_PAGES; i++) {
+			char *mem = cold + i * PAGE_SIZE;
+
+			if (round > 0 && *mem != (char) (i + round - 1))
+				fail ("cold page %zu is inconsistent", i);
+			*mem = (char) (i + round);
+			if (i % HOT_INTERVAL == 0)
+				touch_hot ();
+		}
+	}
+	touch_hot ();
+}
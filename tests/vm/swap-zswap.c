@@ -0,0 +1,39 @@
+/* Fills an array several times larger than memory with data that
+ * compresses well, then reads it back in order and checks it.  The
+ * .ck file checks that zswap kept evicted pages compressed and that
+ * faults were served from it. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_COUNT (16 * 256)
+
+static char pages[PAGE_COUNT][PAGE_SIZE];
+
+/* Byte J of page I: runs of 256 equal bytes. */
+static char
+pattern (size_t i, size_t j)
+{
+	return (char) (i * 31 + j / 256);
+}
+
+void
+test_main (void)
+{
+	size_t i, j;
+
+	msg ("fill %d pages", PAGE_COUNT);
+	for (i = 0; i < PAGE_COUNT; i++)
+		for (j = 0; j < PAGE_SIZE; j++)
+			pages[i][j] = pattern (i, j);
+
+	msg ("check %d pages", PAGE_COUNT);
+	for (i = 0; i < PAGE_COUNT; i++)
+		for (j = 0; j < PAGE_SIZE; j++)
+			if (pages[i][j] != pattern (i, j))
+				fail ("page %zu is inconsistent", i);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::vm::swap_stats;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-zswap) begin
+(swap-zswap) fill 4096 pages
+(swap-zswap) check 4096 pages
+(swap-zswap) end
+EOF
+check_zswap ();
+pass;
@@ -0,0 +1,54 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+# Returns the line of the kernel's shutdown statistics that starts
+# with $PREFIX, failing if there is none.
+sub get_stats_line {
+    my ($prefix) = @_;
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    my ($line) = grep (/^\Q$prefix\E/, @output);
+    fail "Output missing '$prefix' statistics.\n" if !defined $line;
+    return $line;
+}
+
+# Checks that the kernel ran with replacement policy $POLICY and
+# that it had to evict pages.
+sub check_eviction_policy {
+    my ($policy) = @_;
+    my ($line) = get_stats_line ("Eviction (");
+    my ($used, $evictions) = $line =~ /^Eviction \((\S+)\):.* (\d+) evictions/
+      or fail "Malformed eviction statistics: $line\n";
+    fail "Kernel used policy $used, expected $policy.\n" if $used ne $policy;
+    fail "No pages were evicted.\n" if $evictions == 0;
+}
+
+# Checks that pages went out to the swap disk several to a write,
+# and that some of the faults that brought them back in were served
+# by read-ahead.
+sub check_swap_clustering {
+    my ($line) = get_stats_line ("Swap: ");
+    my ($out, $writes, $ahead, $hits)
+      = $line =~ /(\d+) pages out in (\d+) writes, .* (\d+) read ahead, (\d+) cache hits/
+      or fail "Malformed swap statistics: $line\n";
+    fail "No pages were written to the swap disk.\n" if $writes == 0;
+    fail "$out pages went out in $writes writes.\n" if $out < 2 * $writes;
+    fail "No pages were read ahead.\n" if $ahead == 0;
+    fail "No faults were served by read-ahead.\n" if $hits == 0;
+}
+
+# Checks that zswap kept evicted pages compressed to less than half
+# their size, and that some faults were served from it.
+sub check_zswap {
+    my ($line) = get_stats_line ("Zswap: ");
+    my ($stored, $pct, $hits)
+      = $line =~ /(\d+) stored at (\d+)% of their size, .* (\d+) of \d+ loads hit/
+      or fail "Malformed zswap statistics: $line\n";
+    fail "No pages were stored compressed.\n" if $stored == 0;
+    fail "Pages were stored at $pct% of their size.\n" if $pct >= 50;
+    fail "No faults were served from zswap.\n" if $hits == 0;
+}
+
+1;
@@ -19,7 +19,10 @@
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/vmalloc.h"
 #include "threads/pte.h"
+#include "threads/schedtrace.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -31,6 +34,9 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/evict.h"
+#include "vm/swap.h"
+#include "vm/image.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -85,7 +91,9 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	slab_init ();
 	paging_init (mem_end);
+	vmalloc_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -146,22 +154,26 @@ bss_init (void) {
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
-	int perm;
+	uint64_t pa;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
-	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
-		uint64_t va = (uint64_t) ptov(pa);
-
-		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
-			perm &= ~PTE_W;
-
+	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end],
+	//   2 MB at a time where possible.
+	for (pa = 0; pa + HUGE_PGSIZE <= mem_end; pa += HUGE_PGSIZE)
+		if ((pte = pml4e_walk_huge (pml4, (uint64_t) ptov (pa), 1)) != NULL)
+			*pte = pa | PTE_P | PTE_W | PTE_PS;
+	for (; pa < mem_end; pa += PGSIZE)
+		if ((pte = pml4e_walk (pml4, (uint64_t) ptov (pa), 1)) != NULL)
+			*pte = pa | PTE_P | PTE_W;
+
+	// Make the kernel text read-only.  This splits the 2 MB pages
+	//   that it only partly covers.
+	for (uint64_t va = (uint64_t) &start; va < (uint64_t) &_end_kernel_text;
+			va += PGSIZE)
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
-			*pte = pa | perm;
-	}
+			*pte &= ~(uint64_t) PTE_W;
 
 	// reload cr3
 	pml4_activate(0);
@@ -221,16 +233,32 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-fair"))
+			thread_fair = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-schedtrace"))
+			schedtrace_enabled = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-vmpolicy")) {
+			if (value == NULL || !evict_set_policy (value))
+				PANIC ("unknown page replacement policy `%s'",
+						value != NULL ? value : "");
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
 
+	if (thread_mlfqs && thread_fair)
+		PANIC ("-mlfqs and -fair are mutually exclusive");
+
 	return argv;
 }
 
@@ -326,8 +354,15 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -fair              Use fair-share (virtual runtime) scheduler.\n"
+			"  -tickless          Stop the periodic timer tick while idle.\n"
+			"  -schedtrace        Trace the scheduler and print histograms.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -vmpolicy=POLICY   Use page replacement POLICY: clock (default),\n"
+			"                     wsclock, 2q or arc.\n"
 #endif
 			);
 	power_off ();
@@ -354,6 +389,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	schedtrace_print_stats ();
+	palloc_print_stats ();
+	slab_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -362,4 +400,9 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	evict_print_stats ();
+	swap_print_stats ();
+	image_print_stats ();
+#endif
 }
@@ -5,9 +5,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -32,7 +35,20 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   page allocator has no run of free pages that long, the pages
+   come from vmalloc() instead.
+
+   In front of each descriptor's free list is a small "magazine"
+   of free blocks.  Most calls to malloc() and free() only pop
+   from or push onto the magazine, with interrupts briefly
+   disabled, and never touch the descriptor's lock.  When a magazine runs empty it is refilled with
+   MAG_BATCH blocks from the free list in one go, and when it
+   overflows MAG_BATCH blocks are drained back the same way. */
+
+/* Blocks a magazine holds, and blocks moved per refill/drain. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
 
 /* Descriptor. */
 struct desc {
@@ -57,19 +73,34 @@ struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
+/* Smallest block size, as a power of 2. */
+#define MIN_BLOCK_SHIFT 4
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Cache of free blocks for one descriptor. */
+struct magazine {
+	size_t cnt;                 /* Number of blocks in BLOCKS. */
+	struct block *blocks[MAG_SIZE]; /* Free blocks, used as a stack. */
+};
+
+/* Magazines, indexed by descriptor. */
+static struct magazine mags[sizeof descs / sizeof *descs];
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *refill (struct desc *);
+static void drain (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
 	size_t block_size;
 
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
+	for (block_size = 1 << MIN_BLOCK_SHIFT; block_size < PGSIZE / 2;
+			block_size *= 2) {
 		struct desc *d = &descs[desc_cnt++];
 		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
 		d->block_size = block_size;
@@ -79,6 +110,24 @@ malloc_init (void) {
 	}
 }
 
+/* Returns the index of the smallest descriptor whose blocks hold
+   SIZE bytes, which may be DESC_CNT or more if none do.  SIZE
+   must be nonzero. */
+static inline size_t
+desc_index (size_t size) {
+	if (size <= 1 << MIN_BLOCK_SHIFT)
+		return 0;
+	return 64 - __builtin_clzll (size - 1) - MIN_BLOCK_SHIFT;
+}
+
+/* Returns the magazine for descriptor D.  Interrupts must be
+   off. */
+static inline struct magazine *
+desc_magazine (struct desc *d) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	return &mags[d - descs];
+}
+
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
@@ -86,6 +135,9 @@ malloc (size_t size) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t idx;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
@@ -93,14 +145,14 @@ malloc (size_t size) {
 
 	/* Find the smallest descriptor that satisfies a SIZE-byte
 	   request. */
-	for (d = descs; d < descs + desc_cnt; d++)
-		if (d->block_size >= size)
-			break;
-	if (d == descs + desc_cnt) {
+	idx = desc_index (size);
+	if (idx >= desc_cnt) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
 		a = palloc_get_multiple (0, page_cnt);
+		if (a == NULL && page_cnt > 1)
+			a = vmalloc (page_cnt * PGSIZE);
 		if (a == NULL)
 			return NULL;
 
@@ -111,6 +163,33 @@ malloc (size_t size) {
 		a->free_cnt = page_cnt;
 		return a + 1;
 	}
+	d = &descs[idx];
+
+	/* Take a block from the magazine if it has one. */
+	old_level = intr_disable ();
+	m = desc_magazine (d);
+	if (m->cnt > 0) {
+		b = m->blocks[--m->cnt];
+		intr_set_level (old_level);
+		return b;
+	}
+	intr_set_level (old_level);
+
+	return refill (d);
+}
+
+/* Takes up to MAG_BATCH blocks from D's free list, creating a new
+   arena if it is empty.  Returns one of them and puts the rest in
+   the magazine.  Returns a null pointer if memory
+   is not available. */
+static struct block *
+refill (struct desc *d) {
+	struct block *batch[MAG_BATCH];
+	struct block *b;
+	struct arena *a;
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t cnt;
 
 	lock_acquire (&d->lock);
 
@@ -135,12 +214,30 @@ malloc (size_t size) {
 		}
 	}
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
+	/* Get a batch of blocks from the free list. */
+	for (cnt = 0; cnt < MAG_BATCH && !list_empty (&d->free_list); cnt++) {
+		b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+		a = block_to_arena (b);
+		a->free_cnt--;
+		batch[cnt] = b;
+	}
+
+	/* Keep the first for the caller and stock the magazine with the
+	   rest.  Another thread may have stocked it in the meantime, so
+	   whatever does not fit goes back on the free list. */
+	old_level = intr_disable ();
+	m = desc_magazine (d);
+	while (cnt > 1 && m->cnt < MAG_SIZE)
+		m->blocks[m->cnt++] = batch[--cnt];
+	intr_set_level (old_level);
+	while (cnt > 1) {
+		b = batch[--cnt];
+		list_push_front (&d->free_list, &b->free_elem);
+		block_to_arena (b)->free_cnt++;
+	}
+
 	lock_release (&d->lock);
-	return b;
+	return batch[0];
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -207,38 +304,78 @@ free (void *p) {
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			struct magazine *m;
+			enum intr_level old_level;
 
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Put it in the magazine if there is room. */
+			old_level = intr_disable ();
+			m = desc_magazine (d);
+			if (m->cnt < MAG_SIZE) {
+				m->blocks[m->cnt++] = b;
+				intr_set_level (old_level);
+				return;
 			}
+			intr_set_level (old_level);
 
-			lock_release (&d->lock);
+			drain (d, b);
 		} else {
 			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
+			if (is_vmalloc_vaddr (a))
+				vfree (a);
+			else
+				palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Returns block B, plus MAG_BATCH blocks from the magazine, to
+   D's free list.  Frees any arena that becomes
+   entirely unused. */
+static void
+drain (struct desc *d, struct block *b) {
+	struct block *batch[MAG_BATCH + 1];
+	struct magazine *m;
+	enum intr_level old_level;
+	size_t cnt = 0;
+
+	batch[cnt++] = b;
+	old_level = intr_disable ();
+	m = desc_magazine (d);
+	while (cnt <= MAG_BATCH && m->cnt > 0)
+		batch[cnt++] = m->blocks[--m->cnt];
+	intr_set_level (old_level);
+
+	lock_acquire (&d->lock);
+	while (cnt > 0) {
+		struct arena *a;
+
+		b = batch[--cnt];
+		a = block_to_arena (b);
+
+		/* Add block to free list. */
+		list_push_front (&d->free_list, &b->free_elem);
+
+		/* If the arena is now entirely unused, free it. */
+		if (++a->free_cnt >= d->blocks_per_arena) {
+			size_t i;
+
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			for (i = 0; i < d->blocks_per_arena; i++) {
+				struct block *b = arena_to_block (a, i);
+				list_remove (&b->free_elem);
+			}
+			palloc_free_page (a);
+		}
+	}
+	lock_release (&d->lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
@@ -8,11 +8,39 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Replaces the 2 MB mapping in page directory entry PDE by a page
+ * table of 4 kB mappings of the same frames, with the same
+ * permissions, so that the permissions of single pages can be
+ * changed.  The translation itself does not change, so no TLB
+ * flush is needed.  Returns false if memory allocation failed. */
+static bool
+pde_split (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*pde);
+	uint64_t flags = *pde & PTE_FLAGS & ~(uint64_t) PTE_PS;
+
+	ASSERT (*pde & PTE_PS);
+	ASSERT (pa % HUGE_PGSIZE == 0);
+
+	if (pt == NULL)
+		return false;
+	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	return true;
+}
+
+/* If HUGE, returns the page directory entry for VA instead of
+ * the page table entry.  A 2 MB mapping found on the way to a
+ * page table entry is split first if CREATE, and otherwise leaves
+ * no page table entry to return. */
 static uint64_t *
-pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
+pgdir_walk (uint64_t *pdp, const uint64_t va, int create, bool huge) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
+		if (huge)
+			return &pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -22,6 +50,9 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 					return NULL;
 			} else
 				return NULL;
+		} else if (pdp[idx] & PTE_PS) {
+			if (!create || !pde_split (&pdp[idx]))
+				return NULL;
 		}
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
@@ -29,7 +60,7 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 }
 
 static uint64_t *
-pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
+pdpe_walk (uint64_t *pdpe, const uint64_t va, int create, bool huge) {
 	uint64_t *pte = NULL;
 	int idx = PDPE (va);
 	int allocated = 0;
@@ -46,7 +77,7 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
+		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create, huge);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
@@ -55,14 +86,8 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 	return pte;
 }
 
-/* Returns the address of the page table entry for virtual
- * address VADDR in page map level 4, pml4.
- * If PML4E does not have a page table for VADDR, behavior depends
- * on CREATE.  If CREATE is true, then a new page table is
- * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
-uint64_t *
-pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
+static uint64_t *
+pml4_walk (uint64_t *pml4e, const uint64_t va, int create, bool huge) {
 	uint64_t *pte = NULL;
 	int idx = PML4 (va);
 	int allocated = 0;
@@ -79,7 +104,7 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
+		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create, huge);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
@@ -88,6 +113,30 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the address of the page table entry for virtual
+ * address VADDR in page map level 4, pml4.
+ * If PML4E does not have a page table for VADDR, behavior depends
+ * on CREATE.  If CREATE is true, then a new page table is
+ * created and a pointer into it is returned.  Otherwise, a null
+ * pointer is returned.
+ * If VADDR is covered by a 2 MB mapping, that mapping is split
+ * into 4 kB ones first if CREATE is true, and a null pointer is
+ * returned if that fails.  Otherwise a null pointer is returned,
+ * and pml4e_walk_huge() finds the mapping. */
+uint64_t *
+pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
+	return pml4_walk (pml4e, va, create, false);
+}
+
+/* Returns the address of the page directory entry for virtual
+ * address VADDR in page map level 4, pml4.  Storing a frame
+ * address with PTE_PS there maps a whole 2 MB page.  The upper
+ * levels are created if CREATE is true, as in pml4e_walk(). */
+uint64_t *
+pml4e_walk_huge (uint64_t *pml4e, const uint64_t va, int create) {
+	return pml4_walk (pml4e, va, create, true);
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,6 +171,9 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
+		/* 2 MB mappings have no page table entries to visit. */
+		if (((uint64_t) pte) & PTE_PS)
+			continue;
 		if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
@@ -288,6 +340,23 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 	}
 }
 
+/* Makes the PTE for virtual page VPAGE in PML4 writable if
+ * WRITABLE is true, read-only otherwise.  Other bits in the page
+ * table entry are preserved. */
+void
+pml4_set_writable (uint64_t *pml4, const void *vpage, bool writable) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	if (pte) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
+
+		if (rcr3 () == vtop (pml4))
+			invlpg ((uint64_t) vpage);
+	}
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 has been
  * accessed recently, that is, between the time the PTE was
  * installed and the last time it was cleared.  Returns false if
@@ -2,6 +2,7 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -24,13 +25,58 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  A block of order N is 2**N pages long and starts
+   at a page index (relative to the pool base) that is a
+   multiple of 2**N.  Each order has its own free list, so a
+   request is satisfied by taking the smallest free block that
+   fits and splitting it, and a freed block is merged with its
+   buddy for as long as the buddy is free too.  Both take
+   O(log n) steps instead of a scan over the whole pool.
+   Requests that are not a power of two are rounded up and the
+   unused tail is given straight back, so no pages are wasted.
+
+   The bitmap of used pages is kept alongside the free lists
+   only to catch double frees and other misuse.
+
+   When the CPU has nothing else to do, the idle thread calls
+   palloc_zero_idle() to take free pages out of each pool, zero
+   them and keep them in the pool's "zero stash".  Single-page
+   PAL_ZERO requests are served from the stash, so they skip the
+   memset().  A pool that runs out of free pages gives its stash
+   back before failing a request. */
+
+/* Largest block order: 2**18 pages, or 1 GB. */
+#define PALLOC_MAX_ORDER 18
+
+/* Most zeroed pages a pool keeps in its stash. */
+#define ZERO_STASH_MAX 32
+
+/* Buddy bookkeeping for one page of a pool.  Only the first
+   page of a free block is on a free list and has FREE set. */
+struct buddy {
+	struct list_elem elem;          /* Element in free_list[ORDER]
+	                                   or zero_stash. */
+	uint8_t order;                  /* Order of the block, if free. */
+	bool free;                      /* Heads a free block? */
+};
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct spinlock lock;           /* Mutual exclusion. */
+	struct bitmap *used_map;        /* Bitmap of used pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Number of pages in pool. */
+	struct buddy *pages;            /* Per-page buddy bookkeeping. */
+	struct list free_list[PALLOC_MAX_ORDER + 1]; /* Free blocks by order. */
+	size_t free_blocks[PALLOC_MAX_ORDER + 1];    /* Lengths of free_list. */
+	size_t free_pages;              /* Total free pages. */
+	struct list zero_stash;         /* Allocated pages known to be zero. */
+	size_t zero_cnt;                /* Pages in zero_stash. */
+	long long zero_hits;            /* PAL_ZERO pages from zero_stash. */
+	long long zero_misses;          /* PAL_ZERO pages zeroed on demand. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +88,9 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_alloc (struct pool *, size_t page_cnt);
+static void pool_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void stash_drain (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -223,12 +272,12 @@ split:
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_free (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool_free (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,10 +311,26 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	size_t page_idx = BITMAP_ERROR;
+	bool zeroed = false;
+
+	spinlock_acquire (&pool->lock);
+	if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zero_cnt > 0) {
+		struct list_elem *e = list_pop_front (&pool->zero_stash);
+		page_idx = list_entry (e, struct buddy, elem) - pool->pages;
+		pool->zero_cnt--;
+		pool->zero_hits++;
+		zeroed = true;
+	} else {
+		page_idx = pool_alloc (pool, page_cnt);
+		if (page_idx == BITMAP_ERROR && pool->zero_cnt > 0) {
+			stash_drain (pool);
+			page_idx = pool_alloc (pool, page_cnt);
+		}
+		if (page_idx != BITMAP_ERROR && (flags & PAL_ZERO))
+			pool->zero_misses++;
+	}
+	spinlock_release (&pool->lock);
 	void *pages;
 
 	if (page_idx != BITMAP_ERROR)
@@ -274,7 +339,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 		pages = NULL;
 
 	if (pages) {
-		if (flags & PAL_ZERO)
+		if ((flags & PAL_ZERO) && !zeroed)
 			memset (pages, 0, PGSIZE * page_cnt);
 	} else {
 		if (flags & PAL_ASSERT)
@@ -318,8 +383,10 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	spinlock_acquire (&pool->lock);
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_free (pool, page_idx, page_cnt);
+	spinlock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +395,37 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Zeroes one free page and puts it in its pool's zero stash, if
+   a pool's stash is short and the pool has pages to spare.
+   Returns false if there was nothing to do.  Called by the idle
+   thread with interrupts on. */
+bool
+palloc_zero_idle (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+
+	for (size_t i = 0; i < sizeof pools / sizeof *pools; i++) {
+		struct pool *p = pools[i];
+		size_t page_idx = BITMAP_ERROR;
+
+		spinlock_acquire (&p->lock);
+		if (p->zero_cnt < ZERO_STASH_MAX
+				&& p->free_pages > 2 * ZERO_STASH_MAX)
+			page_idx = pool_alloc (p, 1);
+		spinlock_release (&p->lock);
+		if (page_idx == BITMAP_ERROR)
+			continue;
+
+		memset (p->base + PGSIZE * page_idx, 0, PGSIZE);
+
+		spinlock_acquire (&p->lock);
+		list_push_back (&p->zero_stash, &p->pages[page_idx].elem);
+		p->zero_cnt++;
+		spinlock_release (&p->lock);
+		return true;
+	}
+	return false;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -335,11 +433,25 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bm_size = ROUND_UP (bitmap_buf_size (pgcnt), sizeof (void *));
+	size_t bm_pages = DIV_ROUND_UP (bm_size + pgcnt * sizeof (struct buddy),
+			PGSIZE) * PGSIZE;
+	int order;
 
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	spinlock_init (&p->lock);
+	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_size);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->pages = (struct buddy *) ((uint8_t *) *bm_base + bm_size);
+	memset (p->pages, 0, pgcnt * sizeof (struct buddy));
+	for (order = 0; order <= PALLOC_MAX_ORDER; order++) {
+		list_init (&p->free_list[order]);
+		p->free_blocks[order] = 0;
+	}
+	p->free_pages = 0;
+	list_init (&p->zero_stash);
+	p->zero_cnt = 0;
+	p->zero_hits = p->zero_misses = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
@@ -347,6 +459,167 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	*bm_base += bm_pages;
 }
 
+/* Takes the free block of P that starts at page PAGE_IDX off
+   its free list. */
+static void
+block_remove (struct pool *p, size_t page_idx) {
+	struct buddy *b = &p->pages[page_idx];
+
+	ASSERT (b->free);
+	list_remove (&b->elem);
+	b->free = false;
+	p->free_blocks[b->order]--;
+	p->free_pages -= (size_t) 1 << b->order;
+}
+
+/* Puts the block of 2**ORDER pages of P that starts at page
+   PAGE_IDX on the free list for ORDER. */
+static void
+block_insert (struct pool *p, size_t page_idx, int order) {
+	struct buddy *b = &p->pages[page_idx];
+
+	ASSERT (!b->free);
+	ASSERT (page_idx % ((size_t) 1 << order) == 0);
+	b->order = order;
+	b->free = true;
+	list_push_front (&p->free_list[order], &b->elem);
+	p->free_blocks[order]++;
+	p->free_pages += (size_t) 1 << order;
+}
+
+/* Frees the block of 2**ORDER pages of P that starts at page
+   PAGE_IDX, merging it with its buddy for as long as the buddy
+   is a free block of the same order. */
+static void
+block_free (struct pool *p, size_t page_idx, int order) {
+	while (order < PALLOC_MAX_ORDER) {
+		size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+		struct buddy *b;
+
+		if (buddy_idx >= p->page_cnt)
+			break;
+		b = &p->pages[buddy_idx];
+		if (!b->free || b->order != order)
+			break;
+		block_remove (p, buddy_idx);
+		page_idx &= ~((size_t) 1 << order);
+		order++;
+	}
+	block_insert (p, page_idx, order);
+}
+
+/* Allocates PAGE_CNT contiguous pages from P and returns the
+   index of the first one, or BITMAP_ERROR if no free block is
+   big enough.  P's lock must be held. */
+static size_t
+pool_alloc (struct pool *p, size_t page_cnt) {
+	struct buddy *b;
+	size_t page_idx, block_cnt;
+	int order, o;
+
+	for (order = 0; ((size_t) 1 << order) < page_cnt; order++)
+		if (order == PALLOC_MAX_ORDER)
+			return BITMAP_ERROR;
+
+	for (o = order; o <= PALLOC_MAX_ORDER; o++)
+		if (!list_empty (&p->free_list[o]))
+			break;
+	if (o > PALLOC_MAX_ORDER)
+		return BITMAP_ERROR;
+
+	b = list_entry (list_front (&p->free_list[o]), struct buddy, elem);
+	page_idx = b - p->pages;
+	block_remove (p, page_idx);
+
+	/* Split down to ORDER, freeing the upper half each time. */
+	while (o > order) {
+		o--;
+		block_insert (p, page_idx + ((size_t) 1 << o), o);
+	}
+
+	/* Give back whatever PAGE_CNT did not need. */
+	block_cnt = (size_t) 1 << order;
+	ASSERT (bitmap_none (p->used_map, page_idx, block_cnt));
+	bitmap_set_multiple (p->used_map, page_idx, page_cnt, true);
+	if (page_cnt < block_cnt)
+		pool_free (p, page_idx + page_cnt, block_cnt - page_cnt);
+
+	return page_idx;
+}
+
+/* Returns the PAGE_CNT pages of P starting at page PAGE_IDX to
+   the free lists.  The range need not be a single block: it is
+   split into the largest aligned blocks that fit.  P's lock must
+   be held, or P must not be in use yet. */
+static void
+pool_free (struct pool *p, size_t page_idx, size_t page_cnt) {
+	bitmap_set_multiple (p->used_map, page_idx, page_cnt, false);
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < PALLOC_MAX_ORDER
+				&& page_idx % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		block_free (p, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Gives every page in P's zero stash back to P's free lists.
+   P's lock must be held. */
+static void
+stash_drain (struct pool *p) {
+	while (!list_empty (&p->zero_stash)) {
+		struct list_elem *e = list_pop_front (&p->zero_stash);
+		size_t page_idx = list_entry (e, struct buddy, elem) - p->pages;
+
+		ASSERT (bitmap_test (p->used_map, page_idx));
+		pool_free (p, page_idx, 1);
+	}
+	p->zero_cnt = 0;
+}
+
+/* Prints P's free pages and, for each order, the number of free
+   blocks and the percentage of free pages that sit in blocks too
+   small to satisfy a request of that order. */
+static void
+pool_print_stats (const char *name, struct pool *p) {
+	size_t free_blocks[PALLOC_MAX_ORDER + 1];
+	size_t free_pages, usable, zero_cnt;
+	long long zero_hits, zero_misses;
+	int order, top;
+
+	spinlock_acquire (&p->lock);
+	memcpy (free_blocks, p->free_blocks, sizeof free_blocks);
+	free_pages = p->free_pages;
+	zero_cnt = p->zero_cnt;
+	zero_hits = p->zero_hits;
+	zero_misses = p->zero_misses;
+	spinlock_release (&p->lock);
+
+	printf ("%s pool: %zu of %zu pages free, %zu zeroed in stash, "
+			"%lld PAL_ZERO hits, %lld misses\n", name, free_pages,
+			p->page_cnt, zero_cnt, zero_hits, zero_misses);
+	for (top = PALLOC_MAX_ORDER; top > 0 && free_blocks[top] == 0; top--)
+		continue;
+	usable = free_pages;
+	for (order = 0; order <= top; order++) {
+		printf ("  order %2d: %zu free blocks, %zu%% fragmented\n",
+				order, free_blocks[order],
+				free_pages ? (free_pages - usable) * 100 / free_pages : 0);
+		usable -= free_blocks[order] << order;
+	}
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	pool_print_stats ("Kernel", &kernel_pool);
+	pool_print_stats ("User", &user_pool);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
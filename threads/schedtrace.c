@@ -0,0 +1,142 @@
+#include "threads/schedtrace.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Scheduler event trace.
+
+   When enabled, the scheduler writes every block, unblock,
+   dispatch decision and context switch into a fixed-size ring,
+   overwriting the oldest entries.  Two histograms are kept
+   alongside: how long threads sit in the run queue between
+   becoming ready and being chosen to run, and how deep the run
+   queue is at each dispatch.  Both use power-of-two buckets.
+   Timestamps are raw time-stamp counter values.
+
+   Everything here runs with interrupts off, from inside the
+   scheduler, so it must not sleep or print. */
+
+/* Number of events kept.  Must be a power of 2. */
+#define TRACE_SIZE 1024
+
+/* One scheduler event. */
+struct sched_event {
+	uint64_t tsc;               /* Time-stamp counter. */
+	int64_t arg;                /* Depends on TYPE. */
+	tid_t tid;                  /* Thread the event is about. */
+	uint8_t type;               /* An enum sched_event_type. */
+	uint8_t priority;           /* Thread's priority at the time. */
+};
+
+static struct sched_event trace[TRACE_SIZE];
+static uint64_t trace_cnt;      /* Total events ever recorded. */
+static uint64_t type_cnt[SCHED_EVENT_CNT];  /* Events of each type. */
+
+/* Histograms.  Bucket 0 counts zeros, bucket B > 0 counts values
+   in [2**(B-1), 2**B). */
+#define HIST_BUCKETS 65
+static uint64_t latency_hist[HIST_BUCKETS];
+static uint64_t depth_hist[HIST_BUCKETS];
+
+/* Number of most recent events printed at power off. */
+#define TRACE_PRINT_CNT 32
+
+bool schedtrace_enabled;
+
+static int hist_bucket (uint64_t);
+static void print_hist (const char *title, const uint64_t hist[]);
+
+/* Appends an event of the given TYPE about thread T to the trace. */
+void
+schedtrace_record (enum sched_event_type type, const struct thread *t,
+		int64_t arg) {
+	struct sched_event *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!schedtrace_enabled)
+		return;
+	type_cnt[type]++;
+	e = &trace[trace_cnt++ % TRACE_SIZE];
+	e->tsc = rdtsc ();
+	e->arg = arg;
+	e->tid = t->tid;
+	e->type = type;
+	e->priority = t->priority;
+}
+
+/* Notes that T has just entered the run queue. */
+void
+schedtrace_ready (struct thread *t) {
+	if (schedtrace_enabled)
+		t->ready_tsc = rdtsc ();
+}
+
+/* Notes that T has been chosen to run while DEPTH other threads
+   were left in the run queue. */
+void
+schedtrace_pick (struct thread *t, size_t depth) {
+	if (!schedtrace_enabled)
+		return;
+
+	/* The idle thread runs without ever having been ready. */
+	if (t->ready_tsc != 0) {
+		latency_hist[hist_bucket (rdtsc () - t->ready_tsc)]++;
+		t->ready_tsc = 0;
+	}
+	depth_hist[hist_bucket (depth)]++;
+	schedtrace_record (SCHED_PICK, t, depth);
+}
+
+/* Prints the histograms and the most recent events. */
+void
+schedtrace_print_stats (void) {
+	static const char *names[] = {
+		[SCHED_BLOCK] = "block",
+		[SCHED_UNBLOCK] = "unblock",
+		[SCHED_PICK] = "pick",
+		[SCHED_LAUNCH] = "launch",
+		[SCHED_DL_MISS] = "dlmiss",
+		[SCHED_DL_THROTTLE] = "dlthrtl",
+	};
+	uint64_t first;
+
+	if (!schedtrace_enabled)
+		return;
+
+	printf ("Sched trace: %llu events\n", trace_cnt);
+	for (int type = 0; type < SCHED_EVENT_CNT; type++)
+		printf ("  %-7s %llu\n", names[type], type_cnt[type]);
+	print_hist ("ready-to-running latency (TSC cycles)", latency_hist);
+	print_hist ("run queue depth at dispatch", depth_hist);
+
+	first = trace_cnt > TRACE_PRINT_CNT ? trace_cnt - TRACE_PRINT_CNT : 0;
+	for (uint64_t i = first; i < trace_cnt; i++) {
+		const struct sched_event *e = &trace[i % TRACE_SIZE];
+		printf ("  %20llu %-7s tid %d pri %d arg %lld\n",
+				e->tsc, names[e->type], e->tid, e->priority, e->arg);
+	}
+}
+
+/* Returns the histogram bucket for X. */
+static int
+hist_bucket (uint64_t x) {
+	return x == 0 ? 0 : 64 - __builtin_clzll (x);
+}
+
+/* Prints the nonempty buckets of HIST under TITLE. */
+static void
+print_hist (const char *title, const uint64_t hist[]) {
+	printf ("Sched trace: %s\n", title);
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		uint64_t lo, hi;
+
+		if (hist[b] == 0)
+			continue;
+		lo = b == 0 ? 0 : 1ULL << (b - 1);
+		hi = b == 0 ? 0 : lo * 2 - 1;
+		printf ("  %20llu..%-20llu %llu\n", lo, hi, hist[b]);
+	}
+}
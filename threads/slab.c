@@ -0,0 +1,259 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator for fixed-size kernel objects.
+
+   Each object cache hands out objects of a single size.  Its
+   memory comes from the page allocator one page at a time; such
+   a page is called a "slab".  A slab starts with a header that
+   records which of its objects are free, as a chain of object
+   indexes, followed by the objects themselves.  Because the
+   chain lives in the header rather than in the free objects,
+   an object's contents survive being freed.  So if the cache
+   has a constructor, it runs only once per object, when its
+   slab is created, and callers must give objects back in their
+   constructed state.
+
+   A cache keeps the slabs that have at least one free object on
+   a list, partially used slabs at the front and empty ones at
+   the back, so that allocations fill up existing slabs first.
+   Full slabs are on no list.  At most SLAB_EMPTY_MAX empty slabs
+   are kept for reuse; further empty slabs go back to the page
+   allocator.
+
+   Compared to malloc(), an object cache wastes no space rounding
+   the size up to a power of 2 and has a lock of its own, rather
+   than one shared by every object of similar size. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0bec
+
+/* Ends a slab's chain of free objects. */
+#define SLAB_END UINT16_MAX
+
+/* Number of empty slabs a cache keeps instead of freeing. */
+#define SLAB_EMPTY_MAX 1
+
+/* An object cache. */
+struct kmem_cache {
+	const char *name;           /* Name, for statistics. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	size_t obj_ofs;             /* Offset of first object in a slab. */
+	void (*ctor) (void *);      /* Constructor, or null. */
+	struct lock lock;           /* Lock. */
+	struct list slabs;          /* Slabs with free objects. */
+	size_t empty_cnt;           /* Empty slabs in SLABS. */
+	struct list_elem elem;      /* Element in cache_list. */
+
+	/* Statistics. */
+	size_t slab_cnt;            /* Slabs owned by the cache. */
+	size_t active_cnt;          /* Objects allocated right now. */
+	long long alloc_cnt;        /* Total kmem_cache_alloc() calls. */
+};
+
+/* A slab: one page of objects. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in cache's slabs list. */
+	uint16_t used_cnt;          /* Objects allocated from this slab. */
+	uint16_t free;              /* Index of first free object. */
+	uint16_t next[];            /* Free chain: NEXT[i] follows i. */
+};
+
+/* All object caches, for statistics. */
+static struct list cache_list;
+static struct lock cache_list_lock;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void *slab_to_obj (struct kmem_cache *, struct slab *, size_t idx);
+
+/* Initializes the slab allocator. */
+void
+slab_init (void) {
+	list_init (&cache_list);
+	lock_init (&cache_list_lock);
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME.
+   If CTOR is nonnull, it is called on every object when the
+   object's slab is created.  Returns a null pointer if memory
+   is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, void (*ctor) (void *)) {
+	struct kmem_cache *c;
+	size_t obj_size, cnt;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0 && size <= PGSIZE / 4);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	/* Fit as many objects as possible in a page, counting one
+	   chain entry for each in the header. */
+	obj_size = ROUND_UP (size, sizeof (void *));
+	cnt = (PGSIZE - sizeof (struct slab)) / (obj_size + sizeof (uint16_t));
+	while (ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t),
+				sizeof (void *)) + cnt * obj_size > PGSIZE)
+		cnt--;
+	ASSERT (cnt > 0 && cnt < SLAB_END);
+
+	c->name = name;
+	c->obj_size = obj_size;
+	c->objs_per_slab = cnt;
+	c->obj_ofs = ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t),
+			sizeof (void *));
+	c->ctor = ctor;
+	lock_init (&c->lock);
+	list_init (&c->slabs);
+	c->empty_cnt = 0;
+	c->slab_cnt = 0;
+	c->active_cnt = 0;
+	c->alloc_cnt = 0;
+
+	lock_acquire (&cache_list_lock);
+	list_push_back (&cache_list, &c->elem);
+	lock_release (&cache_list_lock);
+	return c;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	size_t idx;
+
+	lock_acquire (&c->lock);
+
+	/* If no slab has a free object, create a new one. */
+	if (list_empty (&c->slabs)) {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->slabs, &s->elem);
+		c->empty_cnt++;
+	}
+
+	/* Take the first free object of the first slab. */
+	s = list_entry (list_front (&c->slabs), struct slab, elem);
+	idx = s->free;
+	ASSERT (idx != SLAB_END);
+	s->free = s->next[idx];
+	if (s->used_cnt++ == 0)
+		c->empty_cnt--;
+	if (s->free == SLAB_END)
+		list_remove (&s->elem);
+
+	c->active_cnt++;
+	c->alloc_cnt++;
+	lock_release (&c->lock);
+	return slab_to_obj (c, s, idx);
+}
+
+/* Returns object P, which must have been obtained from cache C
+   by kmem_cache_alloc(), to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *p) {
+	struct slab *s;
+	size_t idx;
+
+	if (p == NULL)
+		return;
+
+	s = pg_round_down (p);
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+	ASSERT ((pg_ofs (p) - c->obj_ofs) % c->obj_size == 0);
+	idx = (pg_ofs (p) - c->obj_ofs) / c->obj_size;
+	ASSERT (idx < c->objs_per_slab);
+
+	lock_acquire (&c->lock);
+
+	/* A full slab gets its first free object back. */
+	if (s->free == SLAB_END)
+		list_push_front (&c->slabs, &s->elem);
+	s->next[idx] = s->free;
+	s->free = idx;
+	c->active_cnt--;
+
+	/* If the slab is now empty, either keep it at the back of the
+	   list or give it back to the page allocator. */
+	if (--s->used_cnt == 0) {
+		list_remove (&s->elem);
+		if (c->empty_cnt < SLAB_EMPTY_MAX) {
+			list_push_back (&c->slabs, &s->elem);
+			c->empty_cnt++;
+		} else {
+			s->magic = 0;
+			c->slab_cnt--;
+			palloc_free_page (s);
+		}
+	}
+
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for each object cache. */
+void
+slab_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&cache_list_lock);
+	for (e = list_begin (&cache_list); e != list_end (&cache_list);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+		printf ("Slab %s: %zu bytes, %zu of %zu objects in use, "
+				"%zu slabs, %lld allocations\n",
+				c->name, c->obj_size, c->active_cnt,
+				c->slab_cnt * c->objs_per_slab, c->slab_cnt, c->alloc_cnt);
+	}
+	lock_release (&cache_list_lock);
+}
+
+/* Obtains a page for cache C, builds its chain of free objects
+   and runs C's constructor on each of them.  Returns the new
+   slab, or a null pointer if memory is not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s;
+	size_t i;
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->used_cnt = 0;
+	s->free = 0;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_END;
+		if (c->ctor != NULL)
+			c->ctor (slab_to_obj (c, s, i));
+	}
+	c->slab_cnt++;
+	return s;
+}
+
+/* Returns the IDX'th object within slab S of cache C. */
+static void *
+slab_to_obj (struct kmem_cache *c, struct slab *s, size_t idx) {
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (idx < c->objs_per_slab);
+	return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
@@ -32,6 +32,23 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* One semaphore in a condition variable's waiters. */
+struct semaphore_elem {
+	struct heap_elem elem;              /* Heap element. */
+	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Thread waiting on it. */
+	uint64_t seq;                       /* Arrival order. */
+};
+
+/* Arrival counter.  Waiters of equal priority are woken in the
+   order they started waiting. */
+static uint64_t waiter_seq;
+
+static bool sema_waiter_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+static bool cond_waiter_less (const struct heap_elem *,
+		const struct heap_elem *, void *aux);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -46,7 +63,7 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	heap_init (&sema->waiters, sema_waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,8 +83,11 @@ sema_down (struct semaphore *sema) {
 
 	old_level = intr_disable ();
 	while (sema->value == 0) {
-		// list_push_back (&sema->waiters, &thread_current ()->elem);
-		list_insert_ordered (&sema->waiters, &thread_current ()->elem, thread_desc_priority, NULL); // P1-2
+		struct thread *curr = thread_current ();
+
+		curr->wait_sema = sema;
+		curr->wait_seq = waiter_seq++;
+		heap_push (&sema->waiters, &curr->wait_elem); // P1-2
 		thread_block ();
 	}
 	sema->value--;
@@ -110,12 +130,11 @@ sema_up (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
-	if (!list_empty (&sema->waiters)) {
-		// max_thread = list_min (&sema->waiters, thread_desc_priority, NULL);
-		// list_remove (max_thread);
-		// thread_unblock (list_entry (max_thread, struct thread, elem));
-		list_sort (&sema->waiters, thread_desc_priority, NULL); // P1-2
-		thread_unblock (list_entry (list_pop_front (&sema->waiters), struct thread, elem));
+	if (!heap_empty (&sema->waiters)) {
+		struct thread *t = heap_entry (heap_pop (&sema->waiters), struct thread,
+				wait_elem); // P1-2
+		t->wait_sema = NULL;
+		thread_unblock (t);
 	}
 	sema->value++;
 	thread_comp_priority (); //P1-2 : donation
@@ -123,6 +142,8 @@ sema_up (struct semaphore *sema) {
 }
 
 static void sema_test_helper (void *sema_);
+static void lock_take (struct lock *);
+static bool donation_enabled (void);
 
 /* Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
@@ -178,6 +199,7 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	lock->priority = PRI_MIN - 1;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -190,26 +212,34 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	// start P1-2 : donation
-	struct thread *curr = thread_current ();
+	old_level = intr_disable ();
 
-	if (!thread_mlfqs) { //P1-3
+	// start P1-2 : donation
+	if (donation_enabled ()) { //P1-3
 		if (lock->holder) {
 			curr->lock = lock;
-			// list_push_back (&lock->holder->donate, &curr->donate_elem); 
-			list_insert_ordered (&lock->holder->donate, &curr->donate_elem, donate_desc_priority, NULL);
-			update_priority ();
+			if (curr->priority > lock->priority) {
+				lock->priority = curr->priority;
+				heap_increase (&lock->holder->locks, &lock->elem);
+				update_priority (lock->holder);
+			}
 		}
 	}
 	// end P1-2 : donation
 
 	sema_down (&lock->semaphore);
 	curr->lock = NULL; // P1-2 : donation
-	lock->holder = thread_current ();
+	lock->holder = curr;
+	if (donation_enabled ())
+		lock_take (lock);
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -222,12 +252,19 @@ bool
 lock_try_acquire (struct lock *lock) {
 	bool success;
 
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
-	if (success)
+	if (success) {
 		lock->holder = thread_current ();
+		if (donation_enabled ())
+			lock_take (lock);
+	}
+	intr_set_level (old_level);
 	return success;
 }
 
@@ -239,16 +276,21 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!thread_mlfqs) { //P1-3
-		remove_lock (lock); //P1-2 : donation
-		reset_priority (); //P1-2 : donation
+	old_level = intr_disable ();
+	if (donation_enabled ()) { //P1-3
+		heap_remove (&curr->locks, &lock->elem); //P1-2 : donation
+		update_priority (curr); //P1-2 : donation
 	}
 
 	lock->holder = NULL;
 	sema_up (&lock->semaphore);
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -261,12 +303,6 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
-	struct semaphore semaphore;         /* This semaphore. */
-};
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -274,7 +310,7 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	heap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -300,6 +336,8 @@ cond_init (struct condition *cond) {
 void
 cond_wait (struct condition *cond, struct lock *lock) {
 	struct semaphore_elem waiter;
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -307,8 +345,13 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
-	// list_push_back (&cond->waiters, &waiter.elem);
-	list_insert_ordered (&cond->waiters, &waiter.elem, sema_desc_priority, NULL); //P1-2
+	waiter.thread = curr;
+	old_level = intr_disable ();
+	waiter.seq = waiter_seq++;
+	curr->wait_cond = cond;
+	curr->wait_cond_elem = &waiter.elem;
+	heap_push (&cond->waiters, &waiter.elem); //P1-2
+	intr_set_level (old_level);
 	lock_release (lock);
 	sema_down (&waiter.semaphore);
 	lock_acquire (lock);
@@ -328,14 +371,14 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED) {
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)) {
-		// struct list_elem *max_thread;
-		// max_thread = list_min (&cond->waiters, sema_desc_priority, NULL);
-		// list_remove (max_thread);
-		// sema_up (&list_entry (max_thread, struct semaphore_elem, elem)->semaphore);
-		list_sort(&cond->waiters, sema_desc_priority, NULL); //P1-2
-		sema_up (&list_entry (list_pop_front (&cond->waiters), struct semaphore_elem, elem)->semaphore);
+	enum intr_level old_level = intr_disable ();
+	if (!heap_empty (&cond->waiters)) {
+		struct semaphore_elem *waiter = heap_entry (heap_pop (&cond->waiters),
+				struct semaphore_elem, elem); //P1-2
+		waiter->thread->wait_cond = NULL;
+		sema_up (&waiter->semaphore);
 	}
+	intr_set_level (old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -349,53 +392,170 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!heap_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
 
+/* Initializes spin lock LOCK as released. */
+void
+spinlock_init (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	lock->locked = 0;
+}
+
+/* Disables interrupts and acquires LOCK, spinning until it is
+   released by whoever holds it.  Spin locks are not recursive.
+
+   Unlike lock_acquire(), this never sleeps, so it may be called
+   from an interrupt handler. */
+void
+spinlock_acquire (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (lock != NULL);
+
+	old_level = intr_disable ();
+	while (__sync_lock_test_and_set (&lock->locked, 1))
+		while (lock->locked)
+			asm volatile ("pause");
+	lock->old_level = old_level;
+}
+
+/* Releases LOCK and restores the interrupt level that was in
+   effect when it was acquired. */
+void
+spinlock_release (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (lock != NULL);
+	ASSERT (lock->locked);
+
+	old_level = lock->old_level;
+	__sync_lock_release (&lock->locked);
+	intr_set_level (old_level);
+}
+
 // start P1-2
-bool
-sema_desc_priority (struct list_elem *l1, struct list_elem *l2, void *aux UNUSED) {
-	struct semaphore_elem *s_l1 = list_entry (l1, struct semaphore_elem, elem);
-	struct semaphore_elem *s_l2 = list_entry (l2, struct semaphore_elem, elem);
+/* Orders threads waiting on a semaphore by priority, then by
+   arrival, earliest first. */
+static bool
+sema_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+	const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+	return a->wait_seq > b->wait_seq;
+}
 
-	struct semaphore *s1 = &s_l1->semaphore;
-	struct semaphore *s2 = &s_l2->semaphore;
+/* Orders waiters on a condition variable by the priority of the
+   waiting thread, then by arrival, earliest first. */
+static bool
+cond_waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+		void *aux UNUSED) {
+	const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem, elem);
+	const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem, elem);
+
+	if (a->thread->priority != b->thread->priority)
+		return a->thread->priority < b->thread->priority;
+	return a->seq > b->seq;
+}
 
-	struct list *waiters_s_l1 = &s1->waiters;
-	struct list *waiters_s_l2 = &s2->waiters;
+/* Moves T to its new place among the waiters of the semaphore
+   and condition variable it is waiting on, if any, after its
+   priority has changed. */
+void
+waiter_requeue (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
 
-	return list_entry (list_begin (waiters_s_l1), struct thread, elem)->priority > list_entry (list_begin (waiters_s_l2), struct thread, elem)->priority;
+	if (t->wait_sema != NULL)
+		heap_update (&t->wait_sema->waiters, &t->wait_elem);
+	if (t->wait_cond != NULL)
+		heap_update (&t->wait_cond->waiters, t->wait_cond_elem);
 }
 // end P1-2
 
 // start P1-2 : donation
-void
-update_priority (void){
-	struct thread * curr = thread_current ();
-	for (int i = 0; i < 8; i++) {
-	// while (1) {
-		if (!curr->lock) {
-			break;
-		}
-		struct thread * holder = curr->lock->holder;
-		holder->priority = curr->priority;
-		curr = holder;
-	}
+/* Returns the highest priority of the threads waiting for LOCK,
+   or PRI_MIN - 1 if there are none. */
+static int
+lock_waiter_priority (struct lock *lock) {
+	struct heap *waiters = &lock->semaphore.waiters;
+
+	if (heap_empty (waiters))
+		return PRI_MIN - 1;
+	return heap_entry (heap_top (waiters), struct thread, wait_elem)->priority;
+}
+
+/* Records that the current thread has just become LOCK's
+   holder.  The threads still waiting for LOCK now donate to it. */
+static void
+lock_take (struct lock *lock) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	lock->priority = lock_waiter_priority (lock);
+	heap_push (&curr->locks, &lock->elem);
+	update_priority (curr);
 }
 
+/* Recomputes T's effective priority as the higher of its own
+   priority and the highest priority waiting for any lock it
+   holds.  If that changes T's priority and T is itself waiting
+   for a lock, the change is passed on to that lock's holder, and
+   so on down the chain for as long as priorities keep changing.
+
+   Each step costs O(log n) in the number of locks the holder
+   holds and in the number of threads waiting for the lock. */
 void
-remove_lock (struct lock * lock){
-	struct list_elem * e;
-	struct thread * curr = thread_current ();
-
-	for (e = list_begin (&curr->donate); e != list_end (&curr->donate); e = list_next (e)){
-		struct thread * t = list_entry (e, struct thread, donate_elem);
-		if (t->lock == lock) {
-			list_remove (&t->donate_elem);
+update_priority (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (;;) {
+		int priority = t->original_priority;
+		struct lock *lock;
+
+		if (!heap_empty (&t->locks)) {
+			lock = heap_entry (heap_top (&t->locks), struct lock, elem);
+			if (lock->priority > priority)
+				priority = lock->priority;
 		}
+		if (priority == t->priority)
+			break;
+		thread_change_priority (t, priority);
+
+		/* T may have been woken up for LOCK but not yet have run,
+		   in which case it is not among the waiters any more. */
+		lock = t->lock;
+		if (lock == NULL || lock->holder == NULL)
+			break;
+		priority = lock_waiter_priority (lock);
+		if (priority == lock->priority)
+			break;
+		lock->priority = priority;
+		heap_update (&lock->holder->locks, &lock->elem);
+		t = lock->holder;
 	}
 }
+
+/* Returns true if locks donate priority.  Only the priority
+   scheduler uses priorities; MLFQS and the fair-share scheduler
+   compute their own. */
+static bool
+donation_enabled (void) {
+	return !thread_mlfqs && !thread_fair;
+}
+
+/* Orders locks by the highest priority of their waiters. */
+bool
+lock_less_priority (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct lock, elem)->priority
+		< heap_entry (b, struct lock, elem)->priority;
+}
 // end P1-2 : donation
 
 // sema_down() // 공유 자원을 사용하고자하는 스레드
@@ -8,9 +8,12 @@
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/schedtrace.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 #include "intrinsic.h"
+#include "devices/timer.h"
 #include "threads/fp.h" // P1-3
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -25,10 +28,94 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list; //P1-1
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   There is one FIFO list per priority level.  Bit P of BITMAP is
+   set if and only if QUEUES[P] is nonempty, so the highest
+   priority ready thread is found with a single bit scan and both
+   enqueue and dequeue take constant time. */
+struct runqueue {
+	struct list queues[PRI_MAX + 1];    /* One list per priority. */
+	uint64_t bitmap;                    /* Nonempty priority levels. */
+	size_t cnt;                         /* Number of ready threads. */
+};
+
+#if PRI_MAX - PRI_MIN >= 64
+#error run queue bitmap holds at most 64 priority levels
+#endif
+
+static struct runqueue ready_rq;        /* Threads ready to run. */
+static struct heap dl_rq;               /* Ready deadline threads, EDF. */
+static struct heap fair_rq;             /* Ready threads by vruntime, -fair. */
+static int64_t min_vruntime;            /* Monotonic floor of vruntimes. */
+static struct list dl_throttled_list;   /* Out of budget, by deadline. */
+
+/* Deadline scheduling class.
+
+   A thread that calls thread_set_deadline(RUNTIME, PERIOD) is
+   guaranteed RUNTIME ns of CPU time in every PERIOD ns.  Ready
+   deadline threads run ahead of all priority (and MLFQS)
+   threads, earliest absolute deadline first.
+
+   Each thread is its own constant bandwidth server: running
+   consumes its budget, and a thread that exhausts it is throttled
+   until its deadline, when the budget is refilled and the
+   deadline moves one period ahead.  A thread that wakes up with
+   more budget than it could use by its deadline gets a fresh
+   deadline instead.  Admission control keeps the total reserved
+   bandwidth at DL_BW_LIMIT, so deadline threads cannot
+   starve the other classes.
+
+   Bandwidth is RUNTIME / PERIOD in fixed point with DL_BW_SHIFT
+   fraction bits. */
+#define DL_BW_SHIFT 20
+#define DL_BW_LIMIT ((95 << DL_BW_SHIFT) / 100)
+static uint64_t dl_total_bw;    /* Bandwidth reserved by all threads. */
+
+/* Fair-share scheduler.
+
+   With "-fair", threads outside the deadline class are ordered
+   by virtual runtime: the nanoseconds of CPU time they have used,
+   scaled by NICE_0_WEIGHT / weight, where the weight falls by
+   about 1.25x for each step of nice.  The thread with the least
+   vruntime runs next, so each thread gets CPU time in proportion
+   to its weight.  The running thread is preempted once it is
+   FAIR_GRANULARITY ns of vruntime ahead of the first ready
+   thread.  A thread that wakes up after sleeping is placed no
+   further than FAIR_GRANULARITY behind min_vruntime,
+   so sleeping does not bank unbounded credit. */
+bool thread_fair;
+
+#define NICE_MIN -20
+#define NICE_MAX 20
+#define NICE_0_WEIGHT 1024
+#define FAIR_GRANULARITY 4000000
+
+static const int nice_weight[NICE_MAX - NICE_MIN + 1] = {
+	/* -20 */ 88761, 71755, 56483, 46273, 36291,
+	/* -15 */ 29154, 23254, 18705, 14949, 11916,
+	/* -10 */ 9548, 7620, 6100, 4904, 3906,
+	/*  -5 */ 3121, 2501, 1991, 1586, 1277,
+	/*   0 */ 1024, 820, 655, 526, 423,
+	/*   5 */ 335, 272, 215, 172, 137,
+	/*  10 */ 110, 87, 70, 56, 45,
+	/*  15 */ 36, 29, 23, 18, 15,
+	/*  20 */ 12,
+};
+
+/* Sleeping threads, hashed into a timer wheel by wakeup time.
+   Slot W holds the threads whose wakeup_time is congruent to W
+   modulo TIMER_WHEEL_SLOTS, sorted by wakeup_time.  The timer
+   interrupt therefore only looks at the slots for the ticks that
+   are actually due, and does nothing at all before next_wakeup. */
+#define TIMER_WHEEL_SLOTS 64
+static struct list timer_wheel[TIMER_WHEEL_SLOTS]; //P1-1
+static int64_t next_wakeup;     /* Earliest wakeup_time, INT64_MAX if none. */
+
+/* List of all processes.  Processes are added to this list by
+   init_thread() and removed when they exit. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -36,16 +123,26 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Pages of destroyed threads, kept for reuse by thread_create()
+   so that creating a thread does not have to go through the page
+   allocator.  Only the struct thread at the bottom of a page is
+   cleared on reuse, by init_thread(); the stack is left as is. */
+#define THREAD_CACHE_MAX 16
+static void *thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+static struct spinlock thread_cache_lock;
+
 /* Statistics. */
 static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
+static uint64_t switch_tsc;     /* TSC at the last thread switch. */
+static uint64_t idle_cycles;    /* # of TSC cycles spent idle. */
+static uint64_t kernel_cycles;  /* # of TSC cycles in kernel threads. */
+static uint64_t user_cycles;    /* # of TSC cycles in user programs. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
@@ -57,14 +154,55 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 bool thread_mlfqs;
 int load_avg; //P1-3
 
+/* MLFQS bookkeeping.  Between two priority recomputations only
+   the threads that ran have their recent_cpu changed, so only
+   the threads on mlfqs_dirty_list are recomputed every fourth
+   tick.  The once-a-second decay touches every thread and makes
+   all of them dirty. */
+static struct list mlfqs_dirty_list;
+static int recent_cpu_decay;    /* (2*load_avg)/(2*load_avg + 1). */
+static void mlfqs_mark_dirty (struct thread *);
+static int mlfqs_formula (struct thread *);
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *next_thread_to_run (void);
-static void init_thread (struct thread *, const char *name, int priority);
+static void init_thread (struct thread *, const char *name, int priority,
+		bool mlfqs);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
+
+static void enqueue (struct thread *);
+static void account_cpu (struct thread *);
+static bool dl_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static bool dl_throttle_less (const struct list_elem *,
+		const struct list_elem *, void *aux);
+static void dl_wakeup (struct thread *);
+static void dl_replenish (void);
+static bool dl_preempts (struct thread *);
+static struct thread *dequeue (void);
+static int64_t fair_delta (int64_t ns, int nice);
+static int64_t fair_vruntime (struct thread *);
+static bool fair_preempts (struct thread *, int64_t gran);
+static bool fair_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static bool is_idle_thread (struct thread *);
+static size_t ready_threads (void);
+
+static void rq_init (struct runqueue *);
+static void rq_push (struct runqueue *, struct thread *);
+static void rq_remove (struct runqueue *, struct thread *);
+static struct thread *rq_pop (struct runqueue *);
+static int rq_max_priority (const struct runqueue *);
+
+static int wheel_slot (int64_t ticks);
+static bool wakeup_asc (const struct list_elem *, const struct list_elem *,
+		void *aux);
 
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
@@ -109,14 +247,22 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list); //P1-1
+	spinlock_init (&thread_cache_lock);
+	rq_init (&ready_rq);
+	heap_init (&dl_rq, dl_less, NULL);
+	heap_init (&fair_rq, fair_less, NULL);
+	list_init (&dl_throttled_list);
+	switch_tsc = rdtsc ();
+	for (int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		list_init (&timer_wheel[i]); //P1-1
+	next_wakeup = INT64_MAX;
 	list_init (&destruction_req);
+	list_init (&all_list);
+	list_init (&mlfqs_dirty_list);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
-	init_thread (initial_thread, "main", PRI_DEFAULT);
+	init_thread (initial_thread, "main", PRI_DEFAULT, true);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
 }
@@ -154,8 +300,24 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	/* Refill the budgets of throttled deadline threads. */
+	dl_replenish ();
+
+	/* Enforce preemption.  Ticks caught up by the idle thread
+	   after a tickless halt are not counted in interrupt
+	   context, and there is nothing to preempt then.  A deadline
+	   thread is also preempted when its budget runs out, or when
+	   a deadline thread with an earlier deadline becomes ready. */
+	if (!intr_context ())
+		return;
+	++thread_ticks;
+	if (dl_preempts (t))
+		intr_yield_on_return ();
+	else if (t->dl_runtime != 0
+			&& t->dl_budget <= timer_tsc_to_ns (rdtsc () - switch_tsc))
+		intr_yield_on_return ();
+	else if (thread_fair ? fair_preempts (t, FAIR_GRANULARITY)
+			: thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
 }
 
@@ -164,6 +326,10 @@ void
 thread_print_stats (void) {
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread: %lld us idle, %lld us kernel, %lld us user\n",
+			timer_tsc_to_ns (idle_cycles) / 1000,
+			timer_tsc_to_ns (kernel_cycles) / 1000,
+			timer_tsc_to_ns (user_cycles) / 1000);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -185,18 +351,20 @@ tid_t
 thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
 	struct thread *t;
+	enum intr_level old_level;
 	tid_t tid;
 
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = alloc_thread_page ();
 	if (t == NULL)
 		return TID_ERROR;
 
-	/* Initialize thread. */
-	init_thread (t, name, priority);
+	/* Initialize thread.  The idle thread stays at PRI_MIN. */
+	init_thread (t, name, priority, function != idle);
 	tid = t->tid = allocate_tid ();
+	t->vruntime = min_vruntime;
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -210,12 +378,20 @@ thread_create (const char *name, int priority,
 	t->tf.eflags = FLAG_IF;
 
 	// start P2-3
-	struct thread *curr = thread_current ();
-	list_push_back(&curr->child, &t->child_elem);
 	// t->files = palloc_get_page(PAL_ZERO); // page 1개 만들기
-	t->files = palloc_get_multiple(PAL_ZERO, FDT_PAGES);
-	if (t->files == NULL)
+	t->files = vzalloc (FDT_PAGES * PGSIZE);
+	if (t->files == NULL) {
+		/* Undo init_thread() before T is anyone's child. */
+		old_level = intr_disable ();
+		list_remove (&t->allelem);
+		if (t->mlfqs_dirty)
+			list_remove (&t->dirty_elem);
+		intr_set_level (old_level);
+		free_thread_page (t);
 		return TID_ERROR;
+	}
+	struct thread *curr = thread_current ();
+	list_push_back(&curr->child, &t->child_elem);
 	t->fd_index = 2;
 	t->files[0] = 1;
 	t->files[1] = 2;
@@ -240,6 +416,8 @@ void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
+	schedtrace_record (SCHED_BLOCK, thread_current (),
+			(int64_t) __builtin_return_address (0));
 	thread_current ()->status = THREAD_BLOCKED;
 	schedule ();
 }
@@ -260,9 +438,17 @@ thread_unblock (struct thread *t) {
 
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
-	// list_push_back (&ready_list, &t->elem);
-	list_insert_ordered (&ready_list, &t->elem, thread_desc_priority, NULL); // P1-2
 	t->status = THREAD_READY;
+	schedtrace_record (SCHED_UNBLOCK, t, running_thread ()->tid);
+	schedtrace_ready (t);
+	if (t->dl_runtime != 0)
+		dl_wakeup (t);
+	else if (thread_fair) {
+		int64_t floor = min_vruntime - FAIR_GRANULARITY;
+		if (t->vruntime < floor)
+			t->vruntime = floor;
+	}
+	enqueue (t);
 	intr_set_level (old_level);
 }
 
@@ -306,9 +492,14 @@ thread_exit (void) {
 	process_exit ();
 #endif
 
-	/* Just set our status to dying and schedule another process.
-	   We will be destroyed during the call to schedule_tail(). */
+	/* Remove thread from all threads list, set our status to dying,
+	   and schedule another process.  That process will destroy us
+	   when it calls do_schedule(). */
 	intr_disable ();
+	dl_total_bw -= thread_current ()->dl_bw;
+	list_remove (&thread_current ()->allelem);
+	if (thread_current ()->mlfqs_dirty)
+		list_remove (&thread_current ()->dirty_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -317,16 +508,12 @@ thread_exit (void) {
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) {
-	struct thread *curr = thread_current ();
 	enum intr_level old_level;
 
 	// ASSERT (!intr_context ());
 	if (!intr_context ()) { //P2-1
 		old_level = intr_disable ();
-		if (curr != idle_thread)
-			// list_push_back (&ready_list, &curr->elem);
-			list_insert_ordered (&ready_list, &curr->elem, thread_desc_priority, NULL); // P1-2
-		do_schedule (THREAD_READY); 
+		do_schedule (THREAD_READY);
 		intr_set_level (old_level);
 	}
 }
@@ -342,28 +529,82 @@ thread_sleep (int64_t ticks) {
 
 	ASSERT (!intr_context ()); // Returns true during processing of an external interrupt and false at all other times. 
 	
-	if (curr != idle_thread) {
+	if (!is_idle_thread (curr)) {
 		curr->wakeup_time = ticks;
-		list_push_back (&sleep_list, &curr->elem);
-		// list_insert_ordered (&sleep_list, &curr->elem, time_asc, NULL);
+		list_insert_ordered (&timer_wheel[wheel_slot (ticks)], &curr->elem,
+				wakeup_asc, NULL);
+		if (ticks < next_wakeup)
+			next_wakeup = ticks;
 		thread_block ();
 	}
 	intr_set_level (old_level);
 }
 
+/* Wakes up every sleeping thread whose wakeup time is at or
+   before TICKS.  Called from the timer interrupt. */
 void
 thread_awake (int64_t ticks) {
-	struct list_elem *e = list_begin (&sleep_list);
-	while (e != list_end (&sleep_list)){
-		struct thread *t = list_entry (e, struct thread, elem);
-		if (t->wakeup_time <= ticks) {
-			e = list_remove(e);
-			thread_unblock(t);
+	int64_t first, last;
+
+	if (ticks < next_wakeup)
+		return;
+
+	/* Every due thread has a wakeup time in [next_wakeup, ticks],
+	   so only the slots for those ticks need to be visited. */
+	first = next_wakeup;
+	last = ticks - first >= TIMER_WHEEL_SLOTS ?
+		first + TIMER_WHEEL_SLOTS - 1 : ticks;
+	for (int64_t tick = first; tick <= last; tick++) {
+		struct list *slot = &timer_wheel[wheel_slot (tick)];
+		while (!list_empty (slot)) {
+			struct thread *t = list_entry (list_front (slot), struct thread, elem);
+			if (t->wakeup_time > ticks)
+				break;
+			list_pop_front (slot);
+			thread_unblock (t);
 		}
-		else {
-			e = list_next(e);
+	}
+
+	/* Each slot is sorted, so the new minimum is at a slot front. */
+	next_wakeup = INT64_MAX;
+	for (int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+		if (!list_empty (&timer_wheel[i])) {
+			struct thread *t = list_entry (list_front (&timer_wheel[i]),
+					struct thread, elem);
+			if (t->wakeup_time < next_wakeup)
+				next_wakeup = t->wakeup_time;
 		}
+}
+
+/* Returns the tick at which the next sleeping thread wakes up,
+   or INT64_MAX if no thread is sleeping. */
+int64_t
+thread_next_wakeup (void) {
+	int64_t wakeup = next_wakeup;
+
+	/* A throttled deadline thread becomes ready at its deadline. */
+	if (!list_empty (&dl_throttled_list)) {
+		struct thread *t = list_entry (list_front (&dl_throttled_list),
+				struct thread, elem);
+		int64_t tick = DIV_ROUND_UP (t->dl_deadline, NSEC_PER_TICK);
+		if (tick < wakeup)
+			wakeup = tick;
 	}
+	return wakeup;
+}
+
+/* Returns the timer wheel slot for wakeup time TICKS. */
+static int
+wheel_slot (int64_t ticks) {
+	return (uint64_t) ticks % TIMER_WHEEL_SLOTS;
+}
+
+/* Orders sleeping threads by ascending wakeup time. */
+static bool
+wakeup_asc (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->wakeup_time
+		< list_entry (b, struct thread, elem)->wakeup_time;
 }
 
 // end P1-1
@@ -371,11 +612,13 @@ thread_awake (int64_t ticks) {
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
-	if (!thread_mlfqs) { //P1-3
+	if (!thread_mlfqs && !thread_fair) { //P1-3
 		// thread_current ()->priority = new_priority;
+		enum intr_level old_level = intr_disable ();
 		thread_current ()->original_priority = new_priority; //P1-2 : donation
-		reset_priority (); //P1-2 : donation
+		update_priority (thread_current ()); //P1-2 : donation
 		thread_comp_priority (); //P1-2
+		intr_set_level (old_level);
 	}
 }
 
@@ -434,6 +677,43 @@ thread_get_recent_cpu (void) {
 	// end P1-3
 }
 
+/* Puts the running thread in the deadline class, reserving
+   RUNTIME ns of CPU time in every PERIOD ns, or takes it out of
+   the class if RUNTIME is 0.  Returns false, and changes nothing,
+   if the reservation would push the total bandwidth of all
+   deadline threads past the admission limit. */
+bool
+thread_set_deadline (int64_t runtime, int64_t period) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	uint64_t bw = 0;
+
+	ASSERT (runtime >= 0);
+	ASSERT (runtime == 0 || (period > 0 && runtime <= period));
+
+	if (runtime != 0)
+		bw = ((uint64_t) runtime << DL_BW_SHIFT) / period;
+
+	old_level = intr_disable ();
+	if (dl_total_bw - curr->dl_bw + bw > (uint64_t) DL_BW_LIMIT) {
+		intr_set_level (old_level);
+		return false;
+	}
+	account_cpu (curr);
+	dl_total_bw = dl_total_bw - curr->dl_bw + bw;
+	curr->dl_bw = bw;
+	curr->dl_runtime = runtime;
+	curr->dl_period = period;
+	curr->dl_budget = runtime;
+	curr->dl_deadline = timer_now () + period;
+	curr->dl_missed = 0;
+	intr_set_level (old_level);
+
+	/* Let EDF decide whether to keep running. */
+	thread_yield ();
+	return true;
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
@@ -453,8 +733,20 @@ idle (void *idle_started_ UNUSED) {
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable ();
+		timer_idle_exit ();
 		thread_block ();
 
+		/* With nothing else to run, zero free pages ahead of
+		   PAL_ZERO requests until some thread becomes ready. */
+		intr_enable ();
+		while (ready_threads () == 0 && palloc_zero_idle ())
+			continue;
+		intr_disable ();
+		if (ready_threads () > 0)
+			continue;
+
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -483,9 +775,12 @@ kernel_thread (thread_func *function, void *aux) {
 
 
 /* Does basic initialization of T as a blocked thread named
-   NAME. */
+   NAME.  Under MLFQS, T starts at the priority the formula gives
+   it instead of PRIORITY, unless MLFQS is false. */
 static void
-init_thread (struct thread *t, const char *name, int priority) {
+init_thread (struct thread *t, const char *name, int priority, bool mlfqs) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -498,9 +793,11 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->magic = THREAD_MAGIC;
 	t->original_priority = priority; //P1-2 : donation
 	t->lock = NULL; //P1-2 : donation
-	list_init (&t->donate); //P1-2 : donation
+	heap_init (&t->locks, lock_less_priority, NULL); //P1-2 : donation
 	t->nice = 0; //P1-3
 	t->recent_cpu = 0; //P1-3
+	if (thread_mlfqs && mlfqs)
+		t->priority = mlfqs_formula (t);
 	// start P2-3
 	list_init(&t->child);
 	sema_init(&t->sema_wait, 0);
@@ -508,19 +805,292 @@ init_thread (struct thread *t, const char *name, int priority) {
 	sema_init(&t->sema_exit, 0);
 	// end P2-3
 	t->running = NULL; //P2-5
+
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->allelem);
+	if (thread_mlfqs && mlfqs)
+		mlfqs_mark_dirty (t);
+	intr_set_level (old_level);
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   the idle thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
+	struct thread *t = dequeue ();
+
+	return t != NULL ? t : idle_thread;
+}
+
+/* Removes and returns the thread that should run next, or returns
+   a null pointer if no thread is ready. */
+static struct thread *
+dequeue (void) {
+	if (!heap_empty (&dl_rq))
+		return heap_entry (heap_pop (&dl_rq), struct thread, dl_elem);
+	if (!heap_empty (&fair_rq))
+		return heap_entry (heap_pop (&fair_rq), struct thread, fair_elem);
+	if (ready_rq.cnt > 0)
+		return rq_pop (&ready_rq);
+	return NULL;
+}
+
+/* Appends T to the run queue.  A deadline thread goes into the
+   deadline queue instead, or onto the throttled list if it has no
+   budget left. */
+static void
+enqueue (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (t->dl_runtime == 0 && thread_fair)
+		heap_push (&fair_rq, &t->fair_elem);
+	else if (t->dl_runtime == 0)
+		rq_push (&ready_rq, t);
+	else if (t->dl_budget > 0)
+		heap_push (&dl_rq, &t->dl_elem);
+	else {
+		t->dl_throttled = true;
+		schedtrace_record (SCHED_DL_THROTTLE, t, t->dl_deadline - timer_now ());
+		list_insert_ordered (&dl_throttled_list, &t->elem, dl_throttle_less, NULL);
+	}
+}
+
+/* Applies the constant bandwidth server wakeup rule to deadline
+   thread T.  If T's deadline has passed, or T's remaining budget
+   would give it more than its reserved bandwidth before that
+   deadline, T starts a new period with a full budget. */
+static void
+dl_wakeup (struct thread *t) {
+	int64_t now = timer_now ();
+	int64_t left = t->dl_deadline - now;
+
+	if (t->dl_throttled)
+		return;
+	if (left <= 0
+			|| (__int128) t->dl_budget * t->dl_period
+				> (__int128) t->dl_runtime * left) {
+		t->dl_deadline = now + t->dl_period;
+		t->dl_budget = t->dl_runtime;
+	}
+}
+
+/* Moves the throttled deadline threads whose deadline has come
+   back into the deadline queue, with a refilled budget and a
+   deadline one period later. */
+static void
+dl_replenish (void) {
+	int64_t now;
+	bool woke = false;
+
+	if (list_empty (&dl_throttled_list))
+		return;
+
+	now = timer_now ();
+	while (!list_empty (&dl_throttled_list)) {
+		struct thread *t = list_entry (list_front (&dl_throttled_list),
+				struct thread, elem);
+		if (t->dl_deadline > now)
+			break;
+		list_pop_front (&dl_throttled_list);
+		t->dl_throttled = false;
+		t->dl_budget += t->dl_runtime;
+		t->dl_deadline += t->dl_period;
+		if (t->dl_deadline <= now || t->dl_budget <= 0) {
+			/* Too far behind to catch up: start over. */
+			t->dl_deadline = now + t->dl_period;
+			t->dl_budget = t->dl_runtime;
+		}
+		heap_push (&dl_rq, &t->dl_elem);
+		woke = true;
+	}
+
+	if (woke && intr_context ())
+		intr_yield_on_return ();
+}
+
+/* Returns true if a ready deadline thread should preempt T, which
+   is running. */
+static bool
+dl_preempts (struct thread *t) {
+	struct thread *first;
+
+	if (heap_empty (&dl_rq))
+		return false;
+	if (t->dl_runtime == 0 || t == idle_thread)
+		return true;
+	first = heap_entry (heap_top (&dl_rq), struct thread, dl_elem);
+	return first->dl_deadline < t->dl_deadline;
+}
+
+/* Orders deadline threads so that the earliest deadline is the
+   greatest. */
+static bool
+dl_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, dl_elem)->dl_deadline
+		> heap_entry (b, struct thread, dl_elem)->dl_deadline;
+}
+
+/* Orders throttled threads by ascending deadline. */
+static bool
+dl_throttle_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct thread, elem)->dl_deadline
+		< list_entry (b, struct thread, elem)->dl_deadline;
+}
+
+/* Charges the TSC cycles since the last thread switch to T, which
+   was running until now. */
+static void
+account_cpu (struct thread *t) {
+	uint64_t now = rdtsc ();
+	uint64_t delta = now - switch_tsc;
+
+	switch_tsc = now;
+	t->cpu_cycles += delta;
+	if (thread_fair && t->dl_runtime == 0 && t != idle_thread) {
+		int64_t min;
+
+		t->vruntime += fair_delta (timer_tsc_to_ns (delta), t->nice);
+		min = t->vruntime;
+
+		if (!heap_empty (&fair_rq)) {
+			struct thread *first = heap_entry (heap_top (&fair_rq),
+					struct thread, fair_elem);
+			if (first->vruntime < min)
+				min = first->vruntime;
+		}
+		if (min > min_vruntime)
+			min_vruntime = min;
+	}
+	if (t->dl_runtime != 0) {
+		int64_t late = timer_now () - t->dl_deadline;
+
+		t->dl_budget -= timer_tsc_to_ns (delta);
+		if (late > 0 && t->dl_missed != t->dl_deadline) {
+			t->dl_missed = t->dl_deadline;
+			schedtrace_record (SCHED_DL_MISS, t, late);
+		}
+	}
+	if (t == idle_thread)
+		idle_cycles += delta;
+#ifdef USERPROG
+	else if (t->pml4 != NULL)
+		user_cycles += delta;
+#endif
 	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+		kernel_cycles += delta;
+}
+
+/* Returns NS nanoseconds of CPU time scaled to virtual runtime
+   for a thread with the given NICE value. */
+static int64_t
+fair_delta (int64_t ns, int nice) {
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+	return ns * NICE_0_WEIGHT / nice_weight[nice - NICE_MIN];
+}
+
+/* Returns the virtual runtime of T, which is running, including
+   its current, not yet accounted, run. */
+static int64_t
+fair_vruntime (struct thread *t) {
+	return t->vruntime
+		+ fair_delta (timer_tsc_to_ns (rdtsc () - switch_tsc), t->nice);
+}
+
+/* Returns true if the first ready thread should preempt T, which
+   is running, because T's virtual runtime is more than GRAN ahead
+   of it. */
+static bool
+fair_preempts (struct thread *t, int64_t gran) {
+	struct thread *first;
+
+	if (heap_empty (&fair_rq) || t->dl_runtime != 0)
+		return false;
+	if (t == idle_thread)
+		return true;
+	first = heap_entry (heap_top (&fair_rq), struct thread, fair_elem);
+	return fair_vruntime (t) - first->vruntime > gran;
+}
+
+/* Orders threads so that the least virtual runtime is the
+   greatest. */
+static bool
+fair_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, fair_elem)->vruntime
+		> heap_entry (b, struct thread, fair_elem)->vruntime;
+}
+
+/* Returns true if T is the idle thread. */
+static bool
+is_idle_thread (struct thread *t) {
+	return t == idle_thread;
+}
+
+/* Returns the number of threads ready to run. */
+static size_t
+ready_threads (void) {
+	return ready_rq.cnt + heap_size (&fair_rq) + heap_size (&dl_rq);
+}
+
+/* Initializes run queue RQ as empty. */
+static void
+rq_init (struct runqueue *rq) {
+	for (int i = PRI_MIN; i <= PRI_MAX; i++)
+		list_init (&rq->queues[i]);
+	rq->bitmap = 0;
+	rq->cnt = 0;
+}
+
+/* Appends T to the back of RQ's queue for T's priority. */
+static void
+rq_push (struct runqueue *rq, struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	list_push_back (&rq->queues[t->priority], &t->elem);
+	rq->bitmap |= 1ULL << t->priority;
+	rq->cnt++;
+}
+
+/* Removes T, which must be in RQ at its current priority. */
+static void
+rq_remove (struct runqueue *rq, struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	list_remove (&t->elem);
+	if (list_empty (&rq->queues[t->priority]))
+		rq->bitmap &= ~(1ULL << t->priority);
+	rq->cnt--;
+}
+
+/* Removes and returns the frontmost thread of the highest
+   nonempty priority level in RQ, which must not be empty. */
+static struct thread *
+rq_pop (struct runqueue *rq) {
+	struct thread *t;
+
+	ASSERT (rq->cnt > 0);
+	t = list_entry (list_front (&rq->queues[rq_max_priority (rq)]),
+			struct thread, elem);
+	rq_remove (rq, t);
+	return t;
+}
+
+/* Returns the highest priority of any thread in RQ, or
+   PRI_MIN - 1 if RQ is empty. */
+static int
+rq_max_priority (const struct runqueue *rq) {
+	if (rq->bitmap == 0)
+		return PRI_MIN - 1;
+	return 63 - __builtin_clzll (rq->bitmap);
 }
 
 /* Use iretq to launch the thread */
@@ -567,6 +1137,8 @@ thread_launch (struct thread *th) {
 	uint64_t tf = (uint64_t) &th->tf;
 	ASSERT (intr_get_level () == INTR_OFF);
 
+	schedtrace_record (SCHED_LAUNCH, th, running_thread ()->tid);
+
 	/* The main switching logic.
 	 * We first restore the whole execution context into the intr_frame
 	 * and then switching to the next thread by calling do_iret.
@@ -631,7 +1203,7 @@ do_schedule(int status) {
 	while (!list_empty (&destruction_req)) {
 		struct thread *victim =
 			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
+		free_thread_page (victim);
 	}
 	thread_current ()->status = status;
 	schedule ();
@@ -640,11 +1212,22 @@ do_schedule(int status) {
 static void
 schedule (void) {
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+	struct thread *next;
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
+
+	/* Charge CURR for its run, then requeue it if it yielded. */
+	account_cpu (curr);
+	if (curr->status == THREAD_READY && !is_idle_thread (curr)) {
+		schedtrace_ready (curr);
+		enqueue (curr);
+	}
+
+	next = next_thread_to_run ();
 	ASSERT (is_thread (next));
+	schedtrace_pick (next, ready_threads ());
+
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
 
@@ -679,118 +1262,177 @@ schedule (void) {
 static tid_t
 allocate_tid (void) {
 	static tid_t next_tid = 1;
-	tid_t tid;
 
-	lock_acquire (&tid_lock);
-	tid = next_tid++;
-	lock_release (&tid_lock);
+	return __sync_fetch_and_add (&next_tid, 1);
+}
 
-	return tid;
+/* Returns a page for a new thread, from the thread page cache if
+   it has one, or a null pointer if no page is available.  The
+   page's contents are undefined. */
+static struct thread *
+alloc_thread_page (void) {
+	struct thread *t = NULL;
+
+	spinlock_acquire (&thread_cache_lock);
+	if (thread_cache_cnt > 0)
+		t = thread_cache[--thread_cache_cnt];
+	spinlock_release (&thread_cache_lock);
+
+	return t != NULL ? t : palloc_get_page (0);
+}
+
+/* Returns the page of destroyed thread T to the thread page
+   cache, or to the page allocator if the cache is full. */
+static void
+free_thread_page (struct thread *t) {
+	bool cached = false;
+
+	spinlock_acquire (&thread_cache_lock);
+	if (thread_cache_cnt < THREAD_CACHE_MAX) {
+		thread_cache[thread_cache_cnt++] = t;
+		cached = true;
+	}
+	spinlock_release (&thread_cache_lock);
+
+	if (!cached)
+		palloc_free_page (t);
 }
 
 // start P1-2
+/* Returns true if a thread ready on this CPU should run ahead of
+   the running thread: an earlier deadline, a fair thread far
+   enough behind in virtual runtime, or a higher priority.  Safe to
+   call from an interrupt handler. */
 bool
-thread_desc_priority (struct list_elem *l1, struct list_elem *l2, void *aux UNUSED) {
-	return list_entry (l1, struct thread, elem)->priority > list_entry (l2, struct thread, elem)->priority;
+thread_should_yield (void) {
+	struct thread *curr = thread_current ();
+
+	if (dl_preempts (curr))
+		return true;
+	if (thread_fair)
+		return fair_preempts (curr, FAIR_GRANULARITY / 4);
+	if (curr == idle_thread)
+		return rq_max_priority (&ready_rq) >= PRI_MIN;
+	return curr->dl_runtime == 0 && curr->priority < rq_max_priority (&ready_rq);
 }
 
 void
 thread_comp_priority (void) {
-	if (!list_empty (&ready_list)) {
-		// list_sort(&ready_list, thread_desc_priority, NULL);
-		if (thread_current ()->priority < list_entry (list_front (&ready_list), struct thread, elem)->priority) {
-			thread_yield ();
-		}
-	}
-}
-// end P1-2
-
-// start P1-2 : donation
-bool
-donate_desc_priority (struct list_elem *l1, struct list_elem *l2, void * aux UNUSED) {
-	return list_entry (l1, struct thread, donate_elem)->priority > list_entry (l2, struct thread, donate_elem)->priority;
+	if (thread_should_yield ())
+		thread_yield ();
 }
 
+/* Sets T's effective priority to PRIORITY.  If T is waiting in
+   the run queue it is moved to the queue for its new priority,
+   behind any threads already waiting there.  If T is waiting for
+   a semaphore or condition variable, its place among the other
+   waiters is updated. */
 void
-reset_priority (void) {
-	struct thread * curr = thread_current ();
-	curr->priority = curr->original_priority;
-	if (!list_empty (&curr->donate)) {
-		list_sort(&curr->donate, donate_desc_priority, NULL);
-		struct thread * max_thread = list_entry(list_front(&curr->donate), struct thread, donate_elem);
-		if (max_thread->priority > curr->priority) {
-			curr->priority = max_thread->priority;
+thread_change_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->priority != priority) {
+		if (t->status == THREAD_READY && t->dl_runtime == 0 && !thread_fair) {
+			rq_remove (&ready_rq, t);
+			t->priority = priority;
+			rq_push (&ready_rq, t);
+		} else {
+			t->priority = priority;
+			waiter_requeue (t);
 		}
 	}
+	intr_set_level (old_level);
 }
-// end P1-2 : dontation
+// end P1-2
+
 
 // start P1-3
 void
 mlfqs_priority (struct thread * t) { 
-	if (t != idle_thread) {
-		t->priority = fp_to_int (add_fp_int (div_fp_int (t->recent_cpu, -4), PRI_MAX - t->nice * 2));
-	}
+	if (!is_idle_thread (t))
+		thread_change_priority (t, mlfqs_formula (t));
+}
+
+/* Returns the priority the MLFQS formula gives T,
+   PRI_MAX - recent_cpu/4 - 2*nice, clamped to the valid range. */
+static int
+mlfqs_formula (struct thread *t) {
+	int priority = fp_to_int (add_fp_int (div_fp_int (t->recent_cpu, -4), PRI_MAX - t->nice * 2));
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	return priority;
 }
 
+/* Decays T's recent_cpu by the coefficient last computed by
+   mlfqs_update_recent_cpu() and marks T for recomputation.  A
+   thread with no recent_cpu and no nice value is unchanged. */
 void
 mlfqs_recent_cpu (struct thread * t) {
-	if (t != idle_thread) {
-		t->recent_cpu = add_fp_int (mult_fp (div_fp (mult_fp_int (load_avg, 2), add_fp_int (mult_fp_int (load_avg, 2), 1)), t->recent_cpu), t->nice);
+	if (!is_idle_thread (t) && (t->recent_cpu != 0 || t->nice != 0)) {
+		t->recent_cpu = add_fp_int (mult_fp (recent_cpu_decay, t->recent_cpu), t->nice);
+		mlfqs_mark_dirty (t);
+	}
+}
+
+/* Queues T for priority recomputation by the next
+   mlfqs_update_priority(). */
+static void
+mlfqs_mark_dirty (struct thread *t) {
+	if (!t->mlfqs_dirty) {
+		t->mlfqs_dirty = true;
+		list_push_back (&mlfqs_dirty_list, &t->dirty_elem);
 	}
 }
 
 void
 mlfqs_load_avg (void) {
 	int num_ready_threads;
-	if (thread_current () == idle_thread) {
-		num_ready_threads = list_size (&ready_list);
+	if (is_idle_thread (thread_current ())) {
+		num_ready_threads = ready_threads ();
 	}
 	else {
-		num_ready_threads = list_size (&ready_list) + 1;
-	} 
+		num_ready_threads = ready_threads () + 1;
+	}
 
 	load_avg = add_fp (mult_fp (div_fp_int (int_to_fp (59), 60), load_avg), mult_fp_int (div_fp_int (int_to_fp (1), 60), num_ready_threads));
 }
 
 void
 mlfqs_increment_recent_cpu (void) {
-	if (thread_current () != idle_thread) {
+	if (!is_idle_thread (thread_current ())) {
 		 thread_current ()->recent_cpu = add_fp_int (thread_current ()->recent_cpu, 1);
+		 mlfqs_mark_dirty (thread_current ());
 	}
 }
 
+/* Decays every thread's recent_cpu.  Called once per second,
+   after load_avg has been updated. */
 void
 mlfqs_update_recent_cpu (void) {
-	struct list_elem * e;
-
-	for (e = list_begin (&ready_list); e != list_end (&ready_list); e = list_next (e)) {
-		struct thread * t = list_entry (e, struct thread, elem);
-		mlfqs_recent_cpu (t);
-	}
-
-	for (e = list_begin (&sleep_list); e != list_end (&sleep_list); e = list_next (e)) {
-		struct thread * t = list_entry (e, struct thread, elem);
-		mlfqs_recent_cpu (t);
-	}
+	struct list_elem *e;
+	int twice_load = mult_fp_int (load_avg, 2);
 
-	mlfqs_recent_cpu (thread_current ());
+	recent_cpu_decay = div_fp (twice_load, add_fp_int (twice_load, 1));
+	for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e))
+		mlfqs_recent_cpu (list_entry (e, struct thread, allelem));
 }
 
+/* Recomputes the priority of every thread whose recent_cpu has
+   changed since the last call. */
 void
 mlfqs_update_priority (void) {
-	struct list_elem *e;
-
-	for (e = list_begin (&ready_list); e != list_end (&ready_list); e = list_next (e)) {
-		struct thread *t = list_entry (e, struct thread, elem);
+	while (!list_empty (&mlfqs_dirty_list)) {
+		struct thread *t = list_entry (list_pop_front (&mlfqs_dirty_list),
+				struct thread, dirty_elem);
+		t->mlfqs_dirty = false;
 		mlfqs_priority (t);
 	}
-
-	for (e = list_begin (&sleep_list); e != list_end (&sleep_list); e = list_next (e)) {
-		struct thread *t = list_entry (e, struct thread, elem);
-		mlfqs_priority (t);
-	}
-
-	mlfqs_priority (thread_current ());
 }
+
 // end P1-3
\ No newline at end of file
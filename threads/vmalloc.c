@@ -0,0 +1,167 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Virtually contiguous kernel allocations.
+
+   palloc_get_multiple() needs physically contiguous pages, which
+   may not exist once the kernel pool is fragmented even though
+   plenty of pages are free.  vmalloc() instead takes single pages
+   from the kernel pool wherever they are and maps them side by
+   side in a range of kernel virtual addresses set aside for the
+   purpose.
+
+   Each allocation is followed by one unmapped guard page, so
+   running off its end faults instead of silently corrupting the
+   next allocation.  The guard page also tells vfree() where the
+   allocation ends, so no size needs to be recorded.
+
+   Memory from vmalloc() is not in the direct map, so vtop() does
+   not work on it.
+
+   free() hands large blocks to vfree(), so vfree() may be called
+   wherever free() is, and must not sleep.  The page tables for the
+   whole range are built once at startup, so that mapping and
+   unmapping the pages of a reserved stretch needs no lock at all,
+   and a spin lock guards only the bitmap of reserved pages. */
+
+/* Pages in the vmalloc() range. */
+#define VMALLOC_PAGES ((VMALLOC_END - VMALLOC_START) / PGSIZE)
+
+static struct spinlock vmalloc_lock; /* Protects vmalloc_map. */
+static struct bitmap *vmalloc_map;  /* Used pages of the range. */
+
+static void *vmalloc_pages (size_t page_cnt, enum palloc_flags);
+static size_t unmap_pages (uint8_t *va);
+
+/* Initializes the vmalloc() range.  Must be called after
+   paging_init(). */
+void
+vmalloc_init (void) {
+	uint64_t va;
+
+	/* The range's pml4 entry must already exist, or page maps
+	   created before the first vmalloc() would not see it. */
+	ASSERT (base_pml4 != NULL);
+	ASSERT (base_pml4[PML4 (VMALLOC_START)] & PTE_P);
+	ASSERT (PML4 (VMALLOC_START) == PML4 (VMALLOC_END - 1));
+
+	spinlock_init (&vmalloc_lock);
+	vmalloc_map = bitmap_create (VMALLOC_PAGES);
+	if (vmalloc_map == NULL)
+		PANIC ("vmalloc_init: out of memory");
+
+	/* One page table covers PGSIZE / 8 pages. */
+	for (va = VMALLOC_START; va < VMALLOC_END; va += PGSIZE / 8 * PGSIZE)
+		if (pml4e_walk (base_pml4, va, 1) == NULL)
+			PANIC ("vmalloc_init: out of memory");
+}
+
+/* Obtains and returns SIZE bytes of virtually contiguous kernel
+   memory.  Returns a null pointer if memory or address space is
+   not available. */
+void *
+vmalloc (size_t size) {
+	return vmalloc_pages (DIV_ROUND_UP (size, PGSIZE), 0);
+}
+
+/* Like vmalloc(), but the memory is filled with zeros. */
+void *
+vzalloc (size_t size) {
+	return vmalloc_pages (DIV_ROUND_UP (size, PGSIZE), PAL_ZERO);
+}
+
+/* Frees memory P, which must have been obtained from vmalloc()
+   or vzalloc(). */
+void
+vfree (void *p) {
+	size_t page_idx, page_cnt;
+
+	if (p == NULL)
+		return;
+
+	ASSERT (is_vmalloc_vaddr (p));
+	ASSERT (pg_ofs (p) == 0);
+	page_idx = pg_no (p) - pg_no (VMALLOC_START);
+
+	page_cnt = unmap_pages (p);
+	ASSERT (page_cnt > 0);
+
+	spinlock_acquire (&vmalloc_lock);
+	ASSERT (bitmap_all (vmalloc_map, page_idx, page_cnt + 1));
+	bitmap_set_multiple (vmalloc_map, page_idx, page_cnt + 1, false);
+	spinlock_release (&vmalloc_lock);
+}
+
+/* Maps PAGE_CNT pages obtained from the kernel pool with FLAGS at
+   a free spot in the vmalloc() range and returns its address. */
+static void *
+vmalloc_pages (size_t page_cnt, enum palloc_flags flags) {
+	uint8_t *va;
+	size_t page_idx, i;
+
+	ASSERT (vmalloc_map != NULL);
+	ASSERT (!(flags & PAL_USER));
+
+	if (page_cnt == 0)
+		return NULL;
+
+	/* Reserve one more page than asked for, as a guard. */
+	spinlock_acquire (&vmalloc_lock);
+	page_idx = bitmap_scan_and_flip (vmalloc_map, 0, page_cnt + 1, false);
+	spinlock_release (&vmalloc_lock);
+	if (page_idx == BITMAP_ERROR)
+		goto fail;
+	va = (uint8_t *) VMALLOC_START + page_idx * PGSIZE;
+
+	/* The stretch is ours, and its page tables exist. */
+	for (i = 0; i < page_cnt; i++) {
+		void *kpage = palloc_get_page (flags);
+		uint64_t *pte;
+
+		if (kpage == NULL)
+			goto unmap;
+		pte = pml4e_walk (base_pml4, (uint64_t) va + i * PGSIZE, 0);
+		ASSERT (pte != NULL && !(*pte & PTE_P));
+		*pte = vtop (kpage) | PTE_P | PTE_W;
+	}
+	return va;
+
+unmap:
+	unmap_pages (va);
+	spinlock_acquire (&vmalloc_lock);
+	bitmap_set_multiple (vmalloc_map, page_idx, page_cnt + 1, false);
+	spinlock_release (&vmalloc_lock);
+fail:
+	if (flags & PAL_ASSERT)
+		PANIC ("vmalloc: out of memory");
+	return NULL;
+}
+
+/* Unmaps and frees the pages mapped from VA up to the next
+   unmapped page, and returns how many there were.  The page
+   tables themselves are kept for later allocations. */
+static size_t
+unmap_pages (uint8_t *va) {
+	size_t page_cnt = 0;
+	uint64_t *pte;
+
+	while ((pte = pml4e_walk (base_pml4, (uint64_t) va, 0)) != NULL
+			&& (*pte & PTE_P)) {
+		void *kpage = ptov (PTE_ADDR (*pte));
+
+		*pte = 0;
+		invlpg ((uint64_t) va);
+		palloc_free_page (kpage);
+		va += PGSIZE;
+		page_cnt++;
+	}
+	return page_cnt;
+}
@@ -14,11 +14,16 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/vmalloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #include "vm/vm.h"
+#ifdef VM
+#include "vm/image.h"
+#endif
 
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
@@ -169,6 +174,13 @@ __do_fork (void *aux) {
 		goto error;
 
 	process_activate (current);
+
+	/* The child's lazily loaded segments read its own copy. */
+	if (parent->running != NULL) {
+		current->running = file_duplicate (parent->running);
+		if (current->running == NULL)
+			goto error;
+	}
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
@@ -295,7 +307,7 @@ process_exit (void) {
 	for(int i = 0; i < FDCOUNT_LIMIT; i++){
 		close(i);
 	}
-	palloc_free_multiple(curr->files, FDT_PAGES);
+	vfree (curr->files);
 
 	file_close(curr->running); //P2-5
 
@@ -312,8 +324,9 @@ process_cleanup (void) {
 	struct thread *curr = thread_current ();
 
 #ifdef VM
+	/* Releases every frame of the process, unmapping it, so that
+	 * pml4_destroy() below only frees the page tables. */
 	supplemental_page_table_kill (&curr->spt);
-	return; // P3-extra
 #endif
 
 	uint64_t *pml4;
@@ -730,16 +743,14 @@ lazy_load_segment (struct page *page, void *aux) {
 	size_t page_read_bytes = aux_info -> page_read_bytes;
 	size_t page_zero_bytes = aux_info -> page_zero_bytes;
 
+	uint8_t *kpage = page->frame->kva;
 	if(page_read_bytes > 0) {
-		file_seek(file, ofs);
-		uint8_t *kpage = page->frame->kva;
-		if(file_read(file, kpage, page_read_bytes) != (off_t) page_read_bytes) {
-			vm_dealloc_page(page);
+		if(vm_file_read_at(file, kpage, page_read_bytes, ofs) != (off_t) page_read_bytes) {
 			return false;
 		}
 	}
 
-	memset(page->va + page_read_bytes, 0, page_zero_bytes);
+	memset(kpage + page_read_bytes, 0, page_zero_bytes);
 	return true;
 }
 
@@ -773,14 +784,18 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct lazy_aux *aux = malloc(sizeof (struct lazy_aux));
+		struct lazy_aux *aux = kmem_cache_alloc (lazy_aux_cache);
+		if (aux == NULL)
+			return false;
 		aux -> file = file;
 		aux -> ofs = ofs;
 		aux -> page_read_bytes = page_read_bytes;
 		aux -> page_zero_bytes = page_zero_bytes;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
+		/* Read-only pages can be shared with other processes. */
+		enum vm_type type = writable ? VM_ANON : VM_ANON | VM_IMAGE;
+		if (!vm_alloc_page_with_initializer (type, upage,
 					writable, lazy_load_segment, (void *)aux)){
-			free(aux);
+			kmem_cache_free (lazy_aux_cache, aux);
 			return false;
 		}
 
@@ -17,6 +17,7 @@ void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
 void check_address(const uint64_t *uaddr); //P2-2
+void check_valid_buffer(void *buffer, unsigned size, bool write);
 
 
 // start P2-3 
@@ -78,6 +79,8 @@ syscall_handler (struct intr_frame *f UNUSED) {
 	// TODO: Your implementation goes here.
 	// %rax : syscall num
 	// arg 순서 : %rdi, %rsi, %rdx, %r10, %r8, %r9
+	/* A fault on a user buffer may grow the stack below this. */
+	thread_current ()->rsp = f->rsp;
 	switch(f->R.rax) { 
 		case SYS_HALT:
 			halt();
@@ -204,7 +207,7 @@ int filesize (int fd) {
 
 int read(int fd, void *buffer, unsigned size) {
 	check_address(buffer);
-	check_valid_buffer(buffer, size);
+	check_valid_buffer(buffer, size, true);
 	
 	int read;
 	struct file *open = lookup_fd(fd);
@@ -234,6 +237,7 @@ int read(int fd, void *buffer, unsigned size) {
 
 int write (int fd, const void *buffer, unsigned size) {
 	check_address(buffer);
+	check_valid_buffer((void *) buffer, size, false);
 	int write;
 	struct file *open = lookup_fd(fd);
 	struct thread *curr = thread_current();
@@ -404,8 +408,29 @@ void check_address (const uint64_t *addr) {
 }
 // end 2-2
 
-void check_valid_buffer(void *buffer, unsigned size) {
-	struct page *page = spt_find_page(&thread_current() -> spt, buffer);
-	if(page != NULL && page->writable == false)
+/* Exits unless every page of the SIZE bytes at BUFFER can be read,
+ * and written too if WRITE, by a page fault in the kernel.  Checked
+ * up front, because a fault that fails inside file_read() or
+ * file_write() would exit with FILE_LOCK held. */
+void check_valid_buffer(void *buffer, unsigned size, bool write) {
+	struct thread *curr = thread_current();
+	uint8_t *addr = buffer;
+	uint8_t *end = addr + size;
+
+	if (size == 0)
+		return;
+	if (end < addr || !is_user_vaddr(end - 1))
 		exit(-1);
+	while (addr < end) {
+		struct page *page = spt_find_page(&curr->spt, addr);
+
+		if (page == NULL) {
+			/* Only a write just below the stack grows it. */
+			if (!write || (uintptr_t) addr < curr->rsp - 8
+					|| (uintptr_t) addr >= USER_STACK)
+				exit(-1);
+		} else if (write && !page->writable)
+			exit(-1);
+		addr = (uint8_t *) pg_round_down(addr) + PGSIZE;
+	}
 }
\ No newline at end of file
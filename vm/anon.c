@@ -2,10 +2,9 @@
 
 #include "vm/vm.h"
 #include "devices/disk.h"
-#include "bitmap.h" // P3-5
 #include "threads/vaddr.h" // P3-5
-#include <bitmap.h>
 #include "threads/mmu.h"
+#include "vm/swap.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -13,9 +12,6 @@ static bool anon_swap_in (struct page *page, void *kva);
 static bool anon_swap_out (struct page *page);
 static void anon_destroy (struct page *page);
 
-struct bitmap *swap_slot; //P3-5
-const size_t SECTORS_PER_PAGE = PGSIZE / DISK_SECTOR_SIZE;
-
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -31,7 +27,7 @@ vm_anon_init (void) {
 	swap_disk = NULL;
 	// P3-5
 	swap_disk = disk_get(1, 1); // SWAP
-	swap_slot = bitmap_create(disk_size(swap_disk) / SECTORS_PER_PAGE);
+	swap_init (swap_disk);
 }
 
 /* Initialize the file mapping */
@@ -41,7 +37,7 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 	
 	struct anon_page *anon_page = &page->anon;
-	anon_page -> swap_slot_idx = BITMAP_ERROR;
+	anon_page -> swap_slot_idx = SWAP_SLOT_NONE;
 	return true;
 }
 
@@ -49,18 +45,13 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
-	size_t swap_slot_idx = anon_page -> swap_slot_idx;
+	swap_slot_t swap_slot_idx = anon_page -> swap_slot_idx;
 	
-	if(swap_slot_idx == BITMAP_ERROR) return false;
-
-	for (int i = 0; i < SECTORS_PER_PAGE; i++) {
-		disk_sector_t sec_no = swap_slot_idx * SECTORS_PER_PAGE + i;
-		void * buffer = kva + i * DISK_SECTOR_SIZE;
-		disk_read(swap_disk, sec_no, buffer);
-	}
+	if(swap_slot_idx == SWAP_SLOT_NONE) return false;
 
-	bitmap_set(swap_slot, swap_slot_idx, false);
-	anon_page -> swap_slot_idx = BITMAP_ERROR;
+	swap_read (swap_slot_idx, kva);
+	swap_free (swap_slot_idx);
+	anon_page -> swap_slot_idx = SWAP_SLOT_NONE;
 	return true;
 }
 
@@ -70,28 +61,58 @@ anon_swap_out (struct page *page) {
 	if(page == NULL || page->frame == NULL || page -> frame -> kva == NULL) {
 		return false;
 	}
-	struct anon_page *anon_page = &page->anon;
-	// Find free swap slot
-	size_t swap_slot_idx = bitmap_scan_and_flip(swap_slot, 0, 1, false);
+	return anon_swap_out_cluster (&page->frame, 1) == 1;
+}
 
-	if(swap_slot_idx == BITMAP_ERROR) {
-		PANIC("No Free Swap Slot!");
+/* Swaps out the CNT pinned frames FRAMES[], which must hold
+ * anonymous pages, writing frames that land in adjacent swap slots
+ * with one transfer.  Every page sharing a frame is unmapped and
+ * gets a reference to the frame's slot.  CNT must not exceed
+ * SWAP_CLUSTER.  Returns the number of frames swapped out, counting
+ * from the front; the rest stay mapped, because swap is full. */
+size_t
+anon_swap_out_cluster (struct frame *frames[], size_t cnt) {
+	void *kvas[SWAP_CLUSTER];
+	swap_slot_t slots[SWAP_CLUSTER];
+	struct list_elem *e;
+	size_t done, i;
+
+	ASSERT (cnt <= SWAP_CLUSTER);
+
+	/* Unmap first, so the owners fault and wait instead of
+	 * writing to the frames while they are on their way out. */
+	for (i = 0; i < cnt; i++) {
+		kvas[i] = frames[i]->kva;
+		for (e = list_begin (&frames[i]->pages);
+				e != list_end (&frames[i]->pages); e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+			uint64_t *pml4 = page->owner->pml4;
+
+			pml4_set_dirty(pml4, page->va, false);
+			pml4_clear_page(pml4, page->va);
+		}
 	}
 
-	for (int i = 0; i < SECTORS_PER_PAGE; i++) {
-		disk_sector_t sec_no = swap_slot_idx * SECTORS_PER_PAGE + i;
-		void * buffer = page->frame->kva + i * DISK_SECTOR_SIZE;
-		disk_write(swap_disk, sec_no, buffer);
-	}
+	done = swap_write (kvas, cnt, slots);
 
-	anon_page -> swap_slot_idx = swap_slot_idx;
+	for (i = 0; i < cnt; i++) {
+		bool shared = frames[i]->page_cnt > 1;
 
-	pml4_set_dirty(thread_current() -> pml4, page->va, false);
-	pml4_clear_page(thread_current() -> pml4, page->va);
-	page->frame->page = NULL;
-	page->frame = NULL;
+		for (e = list_begin (&frames[i]->pages);
+				e != list_end (&frames[i]->pages); e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
 
-	return true;
+			if (i >= done)
+				pml4_set_page (page->owner->pml4, page->va, kvas[i],
+						page->writable && !shared);
+			else {
+				if (e != list_begin (&frames[i]->pages))
+					swap_dup (slots[i]);
+				page->anon.swap_slot_idx = slots[i];
+			}
+		}
+	}
+	return done;
 }
 
 
@@ -99,8 +120,12 @@ anon_swap_out (struct page *page) {
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
-	if(page != NULL){
-		free(page);
+	struct anon_page *anon_page = &page->anon;
+
+	/* Give back the swap slot of a page that is swapped out. */
+	if (anon_page -> swap_slot_idx != SWAP_SLOT_NONE) {
+		swap_free (anon_page -> swap_slot_idx);
+		anon_page -> swap_slot_idx = SWAP_SLOT_NONE;
 	}
 }
 // 3-2 end
\ No newline at end of file
@@ -0,0 +1,572 @@
+/* evict.c: Page replacement policies. */
+
+#include "vm/evict.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* The replacement policy decides which frame vm_get_frame() takes
+ * away from its page when user memory runs out.  A policy sees a
+ * frame from the time its first page is brought in (add) until the
+ * frame is evicted or freed (remove), and is asked for a victim
+ * whenever palloc has no user page left.  It may also remember
+ * pages it evicted, to recognize them when they fault back in.
+ *
+ * A frame may be shared by several pages, after fork() or through
+ * the image cache.  The policy keeps one entry for the frame, which
+ * counts as referenced if any sharer referenced it, and evicting it
+ * evicts every sharer, so each of them becomes a ghost.  A frame
+ * that another process starts to map has been used twice, which
+ * 2Q and ARC take as they take a fault on a ghost.
+ *
+ * The hardware keeps no access order, only an accessed bit per
+ * mapping, so every policy here learns about references by testing
+ * and clearing accessed bits when it looks at a frame.  That is
+ * the second-chance idea, and 2Q and ARC use it in place of the
+ * "move to MRU on hit" of their original descriptions.
+ *
+ * The frame table's lock serializes every entry point. */
+
+/* A replacement policy. */
+struct evict_policy {
+	const char *name;
+	void (*init) (void);
+	/* FRAME has just been filled with PAGE. */
+	void (*add) (struct frame *, struct page *);
+	/* FRAME, already known, has just been mapped by another page.
+	 * May be null. */
+	void (*share) (struct frame *);
+	/* Takes FRAME off the policy's lists.  EVICTED tells whether
+	 * the pages still on FRAME were just swapped out of it, rather
+	 * than FRAME being freed. */
+	void (*remove) (struct frame *, bool evicted);
+	/* Returns an evictable frame, or a null pointer. */
+	struct frame *(*victim) (void);
+};
+
+/* A WSClock frame not referenced for this many timer ticks is
+ * outside its process's working set. */
+#define WSCLOCK_TAU (TIMER_FREQ / 2)
+
+static size_t resident;       /* Frames known to the policy. */
+static size_t capacity;       /* Most frames ever resident. */
+
+/* Statistics. */
+static long long fault_cnt;       /* Pages brought in. */
+static long long refault_cnt;     /* ...that had been evicted before. */
+static long long evict_cnt;       /* Pages evicted. */
+static long long writeback_cnt;   /* ...that had to be written out. */
+static long long frame_cnt;       /* Frames evicted. */
+static long long shared_cnt;      /* ...that more than one page mapped. */
+
+/* Frame and ghost list helpers. */
+
+static void
+elist_init (struct evict_list *l) {
+	list_init (&l->list);
+	l->cnt = 0;
+}
+
+/* Puts F on L just before BEFORE. */
+static void
+frame_insert (struct evict_list *l, struct list_elem *before,
+		struct frame *f) {
+	ASSERT (f->evict_list == NULL);
+
+	list_insert (before, &f->evict_elem);
+	l->cnt++;
+	f->evict_list = l;
+}
+
+/* Puts F at the back of L. */
+static void
+frame_enqueue (struct evict_list *l, struct frame *f) {
+	frame_insert (l, list_end (&l->list), f);
+}
+
+/* Takes F off its list. */
+static void
+frame_dequeue (struct frame *f) {
+	list_remove (&f->evict_elem);
+	f->evict_list->cnt--;
+	f->evict_list = NULL;
+}
+
+static struct frame *
+frame_front (struct evict_list *l) {
+	return list_entry (list_front (&l->list), struct frame, evict_elem);
+}
+
+/* Remembers evicted page P at the back of ghost list L. */
+static void
+ghost_push (struct evict_list *l, struct page *p) {
+	ASSERT (p->ghost == NULL);
+
+	list_push_back (&l->list, &p->ghost_elem);
+	l->cnt++;
+	p->ghost = l;
+}
+
+/* Remembers every page on F, which was just evicted, at the back
+ * of ghost list L. */
+static void
+ghost_push_frame (struct evict_list *l, struct frame *f) {
+	struct list_elem *e;
+
+	for (e = list_begin (&f->pages); e != list_end (&f->pages);
+			e = list_next (e))
+		ghost_push (l, list_entry (e, struct page, frame_elem));
+}
+
+/* Forgets ghost page P. */
+static void
+ghost_remove (struct page *p) {
+	list_remove (&p->ghost_elem);
+	p->ghost->cnt--;
+	p->ghost = NULL;
+}
+
+/* Forgets the oldest pages on ghost list L until at most MAX are
+ * left. */
+static void
+ghost_trim (struct evict_list *l, size_t max) {
+	while (l->cnt > max)
+		ghost_remove (list_entry (list_front (&l->list),
+					struct page, ghost_elem));
+}
+
+/* Returns true if F may be evicted: not pinned.  A frame that
+ * several pages share is evicted from all of them at once. */
+static bool
+frame_evictable (struct frame *f) {
+	return !f->pinned;
+}
+
+/* Returns true if any page table that maps F has accessed it
+ * since the last call, clearing the accessed bits. */
+static bool
+frame_referenced (struct frame *f) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&f->pages); e != list_end (&f->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		uint64_t *pml4 = p->owner->pml4;
+
+		if (pml4 != NULL && pml4_is_accessed (pml4, p->va)) {
+			pml4_set_accessed (pml4, p->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Returns true if any page table that maps F has written it. */
+static bool
+frame_dirty (struct frame *f) {
+	struct list_elem *e;
+
+	for (e = list_begin (&f->pages); e != list_end (&f->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+
+		if (p->owner->pml4 != NULL && pml4_is_dirty (p->owner->pml4, p->va))
+			return true;
+	}
+	return false;
+}
+
+/* Returns the first frame on L that is evictable and not
+ * referenced, giving each referenced frame a second chance at the
+ * back of L.  Returns a null pointer if two passes find none. */
+static struct frame *
+second_chance (struct evict_list *l) {
+	size_t i, n = 2 * l->cnt;
+
+	for (i = 0; i < n; i++) {
+		struct frame *f = frame_front (l);
+
+		if (frame_evictable (f) && !frame_referenced (f))
+			return f;
+		list_remove (&f->evict_elem);
+		list_push_back (&l->list, &f->evict_elem);
+	}
+	return NULL;
+}
+
+/* Clock and WSClock.
+ *
+ * All frames are on a ring that a hand sweeps around.  The plain
+ * clock evicts the first frame the hand finds unreferenced.
+ * WSClock also records when each frame was last seen referenced,
+ * and prefers frames that have gone WSCLOCK_TAU ticks without a
+ * reference, clean ones before dirty ones. */
+
+static struct evict_list ring;
+static struct list_elem *hand;   /* Next frame on RING to look at. */
+
+static void
+clock_init (void) {
+	elist_init (&ring);
+	hand = NULL;
+}
+
+/* Adds F just behind the hand, so it is looked at last. */
+static void
+clock_add (struct frame *f, struct page *p UNUSED) {
+	if (hand == NULL)
+		hand = list_end (&ring.list);
+	frame_insert (&ring, hand, f);
+}
+
+static void
+clock_remove (struct frame *f, bool evicted UNUSED) {
+	if (hand == &f->evict_elem)
+		hand = list_next (hand);
+	frame_dequeue (f);
+}
+
+/* Returns the frame under the hand and advances the hand. */
+static struct frame *
+clock_advance (void) {
+	struct frame *f;
+
+	if (hand == NULL || hand == list_end (&ring.list))
+		hand = list_begin (&ring.list);
+	f = list_entry (hand, struct frame, evict_elem);
+	hand = list_next (hand);
+	return f;
+}
+
+static struct frame *
+clock_victim (void) {
+	size_t i;
+
+	for (i = 0; i < 2 * ring.cnt; i++) {
+		struct frame *f = clock_advance ();
+
+		if (frame_evictable (f) && !frame_referenced (f))
+			return f;
+	}
+	return NULL;
+}
+
+static void
+wsclock_add (struct frame *f, struct page *p) {
+	f->last_use = timer_ticks ();
+	clock_add (f, p);
+}
+
+static struct frame *
+wsclock_victim (void) {
+	int64_t now = timer_ticks ();
+	struct frame *dirty = NULL, *oldest = NULL;
+	size_t i;
+
+	for (i = 0; i < 2 * ring.cnt; i++) {
+		struct frame *f = clock_advance ();
+
+		if (!frame_evictable (f))
+			continue;
+		if (frame_referenced (f)) {
+			f->last_use = now;
+			continue;
+		}
+		if (now - f->last_use > WSCLOCK_TAU) {
+			if (!frame_dirty (f))
+				return f;
+			if (dirty == NULL)
+				dirty = f;
+		}
+		if (oldest == NULL || f->last_use < oldest->last_use)
+			oldest = f;
+	}
+
+	/* Everything is in some working set: take the oldest. */
+	return dirty != NULL ? dirty : oldest;
+}
+
+/* 2Q.
+ *
+ * A page brought in for the first time goes on A1IN, a FIFO.  When
+ * it is evicted from there it is remembered on the ghost list
+ * A1OUT.  A page that faults back in while still on A1OUT has been
+ * used twice over some distance, and goes on AM, which is managed
+ * by second chance.  A1IN is limited to a quarter of memory and
+ * A1OUT to half, so that a scan through many pages used once only
+ * churns A1IN and never pushes out the pages on AM. */
+
+static struct evict_list a1in, am, a1out;
+
+static void
+twoq_init (void) {
+	elist_init (&a1in);
+	elist_init (&am);
+	elist_init (&a1out);
+}
+
+static void
+twoq_add (struct frame *f, struct page *p) {
+	if (p->ghost == &a1out) {
+		ghost_remove (p);
+		frame_enqueue (&am, f);
+	} else
+		frame_enqueue (&a1in, f);
+}
+
+/* A frame on A1IN that a second process maps goes to AM. */
+static void
+twoq_share (struct frame *f) {
+	if (f->evict_list == &a1in) {
+		frame_dequeue (f);
+		frame_enqueue (&am, f);
+	}
+}
+
+static void
+twoq_remove (struct frame *f, bool evicted) {
+	struct evict_list *from = f->evict_list;
+
+	frame_dequeue (f);
+	if (evicted && from == &a1in) {
+		ghost_push_frame (&a1out, f);
+		ghost_trim (&a1out, capacity / 2 > 0 ? capacity / 2 : 1);
+	}
+}
+
+/* Returns the oldest evictable frame on L. */
+static struct frame *
+twoq_fifo (struct evict_list *l) {
+	struct list_elem *e;
+
+	for (e = list_begin (&l->list); e != list_end (&l->list);
+			e = list_next (e)) {
+		struct frame *f = list_entry (e, struct frame, evict_elem);
+
+		if (frame_evictable (f))
+			return f;
+	}
+	return NULL;
+}
+
+static struct frame *
+twoq_victim (void) {
+	size_t kin = capacity / 4 > 0 ? capacity / 4 : 1;
+	struct frame *f = NULL;
+
+	if (a1in.cnt > kin || am.cnt == 0)
+		f = twoq_fifo (&a1in);
+	if (f == NULL)
+		f = second_chance (&am);
+	if (f == NULL)
+		f = twoq_fifo (&a1in);
+	return f;
+}
+
+/* ARC.
+ *
+ * T1 holds pages seen once recently and T2 pages seen at least
+ * twice; B1 and B2 remember pages recently evicted from each.  A
+ * fault on a page in B1 means T1 was too small, so the target size
+ * P of T1 grows, and a fault on a page in B2 shrinks it.  Victims
+ * come from T1 while it is at or above its target, otherwise from
+ * T2.  Referenced frames at the front of T1 are promoted to T2 and
+ * those at the front of T2 go to its back, as in CAR, so that the
+ * lists can be kept with accessed bits alone. */
+
+static struct evict_list t1, t2, b1, b2;
+static size_t arc_p;              /* Target size of T1. */
+
+static void
+arc_init (void) {
+	elist_init (&t1);
+	elist_init (&t2);
+	elist_init (&b1);
+	elist_init (&b2);
+	arc_p = 0;
+}
+
+static void
+arc_add (struct frame *f, struct page *p) {
+	size_t c = capacity > 0 ? capacity : 1;
+
+	if (p->ghost == &b1) {
+		size_t d = b2.cnt > b1.cnt ? b2.cnt / b1.cnt : 1;
+
+		arc_p = arc_p + d < c ? arc_p + d : c;
+		ghost_remove (p);
+		frame_enqueue (&t2, f);
+	} else if (p->ghost == &b2) {
+		size_t d = b1.cnt > b2.cnt ? b1.cnt / b2.cnt : 1;
+
+		arc_p = arc_p > d ? arc_p - d : 0;
+		ghost_remove (p);
+		frame_enqueue (&t2, f);
+	} else
+		frame_enqueue (&t1, f);
+}
+
+/* A frame on T1 that a second process maps goes to T2. */
+static void
+arc_share (struct frame *f) {
+	if (f->evict_list == &t1) {
+		frame_dequeue (f);
+		frame_enqueue (&t2, f);
+	}
+}
+
+static void
+arc_remove (struct frame *f, bool evicted) {
+	struct evict_list *from = f->evict_list;
+	size_t c = capacity > 0 ? capacity : 1;
+
+	frame_dequeue (f);
+	if (!evicted)
+		return;
+
+	ghost_push_frame (from == &t1 ? &b1 : &b2, f);
+
+	/* Keep T1 + B1 within C and all four lists within 2 * C. */
+	if (t1.cnt + b1.cnt > c)
+		ghost_trim (&b1, c > t1.cnt ? c - t1.cnt : 0);
+	if (t1.cnt + t2.cnt + b1.cnt + b2.cnt > 2 * c)
+		ghost_trim (&b2, 2 * c - t1.cnt - t2.cnt - b1.cnt);
+}
+
+static struct frame *
+arc_victim (void) {
+	size_t i, n = 2 * (t1.cnt + t2.cnt);
+	struct frame *f;
+
+	for (i = 0; i < n; i++) {
+		bool from_t1 = t1.cnt > 0
+			&& (t1.cnt >= (arc_p > 0 ? arc_p : 1) || t2.cnt == 0);
+		struct evict_list *l = from_t1 ? &t1 : &t2;
+
+		f = frame_front (l);
+		if (!frame_evictable (f)) {
+			list_remove (&f->evict_elem);
+			list_push_back (&l->list, &f->evict_elem);
+		} else if (frame_referenced (f)) {
+			frame_dequeue (f);
+			frame_enqueue (&t2, f);
+		} else
+			return f;
+	}
+
+	/* Whichever list we should take from has nothing to give. */
+	f = second_chance (&t1);
+	return f != NULL ? f : second_chance (&t2);
+}
+
+/* Available policies.  The first one is the default. */
+static const struct evict_policy policies[] = {
+	{"clock", clock_init, clock_add, NULL, clock_remove, clock_victim},
+	{"wsclock", clock_init, wsclock_add, NULL, clock_remove,
+		wsclock_victim},
+	{"2q", twoq_init, twoq_add, twoq_share, twoq_remove, twoq_victim},
+	{"arc", arc_init, arc_add, arc_share, arc_remove, arc_victim},
+};
+
+static const struct evict_policy *policy = &policies[0];
+
+/* Selects the policy named NAME.  Returns false if there is no
+ * such policy.  Must be called before evict_init(). */
+bool
+evict_set_policy (const char *name) {
+	size_t i;
+
+	for (i = 0; i < sizeof policies / sizeof *policies; i++)
+		if (!strcmp (name, policies[i].name)) {
+			policy = &policies[i];
+			return true;
+		}
+	return false;
+}
+
+/* Initializes the selected policy. */
+void
+evict_init (void) {
+	resident = capacity = 0;
+	policy->init ();
+}
+
+/* Tells the policy that FRAME now holds PAGE. */
+void
+evict_add (struct frame *frame, struct page *page) {
+	policy->add (frame, page);
+	if (++resident > capacity)
+		capacity = resident;
+}
+
+/* Tells the policy that another process has mapped FRAME, which
+ * already holds a page. */
+void
+evict_share (struct frame *frame) {
+	if (frame->evict_list != NULL && policy->share != NULL)
+		policy->share (frame);
+}
+
+/* Tells the policy that FRAME is going away, or, if EVICTED, that
+ * it has been taken from the pages still linked to it. */
+void
+evict_remove (struct frame *frame, bool evicted) {
+	if (frame->evict_list == NULL)
+		return;
+	if (evicted) {
+		frame_cnt++;
+		if (frame->page_cnt > 1)
+			shared_cnt++;
+	}
+	policy->remove (frame, evicted);
+	resident--;
+}
+
+/* Returns a frame to evict, or a null pointer if there is none. */
+struct frame *
+evict_victim (void) {
+	return policy->victim ();
+}
+
+/* Forgets PAGE, which is being destroyed. */
+void
+evict_forget (struct page *page) {
+	if (page->ghost != NULL)
+		ghost_remove (page);
+}
+
+/* Counts bringing PAGE into memory. */
+void
+evict_count_fault (struct page *page) {
+	fault_cnt++;
+	if (page->evicted) {
+		refault_cnt++;
+		page->evicted = false;
+	}
+}
+
+/* Counts evicting PAGE, which WRITTEN tells whether had to be
+ * written to swap or to its file. */
+void
+evict_count_eviction (struct page *page, bool written) {
+	evict_cnt++;
+	if (written)
+		writeback_cnt++;
+	page->evicted = true;
+}
+
+/* Prints replacement statistics. */
+void
+evict_print_stats (void) {
+	printf ("Eviction (%s): %lld faults, %lld refaults (%lld%%), "
+			"%lld evictions from %lld frames (%lld shared), "
+			"%lld dirty writebacks\n",
+			policy->name, fault_cnt, refault_cnt,
+			fault_cnt > 0 ? refault_cnt * 100 / fault_cnt : 0,
+			evict_cnt, frame_cnt, shared_cnt, writeback_cnt);
+}
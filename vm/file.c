@@ -5,6 +5,7 @@
 #include "threads/vaddr.h" // P3-5
 #include "userprog/process.h" // P3-5
 #include "threads/mmu.h" // P3-5
+#include "threads/slab.h"
 
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -37,6 +38,7 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	file_page->file = aux->file;
 	file_page->size = aux->page_read_bytes;
 	file_page->ofs = aux->ofs;
+	return true;
 }
 
 /* Swap in the page by read contents from the file. */
@@ -50,11 +52,10 @@ file_backed_swap_in (struct page *page, void *kva) {
 	size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 	if(file_read_at(file, kva, page_read_bytes, ofs) != (off_t) page_read_bytes) {
-		palloc_free_page(kva);
 		return false;
 	}
 
-	memset(page->va + page_read_bytes, 0, page_zero_bytes);
+	memset(kva + page_read_bytes, 0, page_zero_bytes);
 	return true;
 }
 
@@ -63,15 +64,16 @@ static bool
 file_backed_swap_out (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
 
-	uint64_t *pml4 = thread_current()->pml4;
-	if(pml4_is_dirty(pml4, page -> va)) {
-		file_write_at(file_page->file, page->va, file_page->size, file_page->ofs);
-		pml4_set_dirty(pml4, page->va, false);
-	}
+	/* The owner need not be the running thread, so write back
+	 * through the frame rather than the user address. */
+	uint64_t *pml4 = page->owner->pml4;
+	bool dirty = pml4_is_dirty(pml4, page -> va);
 
+	pml4_set_dirty(pml4, page->va, false);
 	pml4_clear_page(pml4, page->va);
-	page->frame->page = NULL;
-	page->frame = NULL;
+	if(dirty) {
+		file_write_at(file_page->file, page->frame->kva, file_page->size, file_page->ofs);
+	}
 	return true;
 }
 
@@ -101,13 +103,12 @@ lazy_load_file (struct page *page, void *aux) {
 	off_t ofs = aux_info -> ofs;
 	size_t page_read_bytes = aux_info -> page_read_bytes;
 
-	file_seek(file, ofs);
-	if(file_read(file, page->va, page_read_bytes) != page_read_bytes){
-		palloc_free_page(page);
+	void *kva = page->frame->kva;
+	if(vm_file_read_at(file, kva, page_read_bytes, ofs) != (off_t) page_read_bytes){
 		return false;
 	}
 	if(page_read_bytes != PGSIZE) {
-		memset(page->va + page_read_bytes, 0, PGSIZE - page_read_bytes);
+		memset(kva + page_read_bytes, 0, PGSIZE - page_read_bytes);
 	}
 	return true;
 }
@@ -127,7 +128,9 @@ do_mmap (void *addr, size_t length, int writable,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		/* TODO: Set up aux to pass information to the lazy_load_file. */
-		struct lazy_aux *aux = (struct lazy_aux *)malloc(sizeof (struct lazy_aux));
+		struct lazy_aux *aux = kmem_cache_alloc (lazy_aux_cache);
+		if (aux == NULL)
+			return NULL;
 		aux -> file = file_reopen(file);
 		aux -> ofs = offset;
 		aux -> page_read_bytes = page_read_bytes;
@@ -0,0 +1,222 @@
+/* image.c: Cache of executable pages shared between processes. */
+
+#include "vm/image.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+
+/* Every process running a program faults in its own copy of the
+ * program's text and read-only data, although those pages are the
+ * same in all of them.  The image cache remembers which frame holds
+ * each such page, keyed by the executable's inode and the page's
+ * offset in it, so that the next process maps that frame instead of
+ * reading the page again.  The frame's PAGE_CNT counts the
+ * processes sharing it.
+ *
+ * When the last of them goes away, the frame stays in the cache,
+ * idle, so that running the program again costs no disk reads.  At
+ * most IMAGE_IDLE_MAX frames are idle at once, the least recently
+ * used going first, and vm_get_frame() takes idle frames back
+ * before it evicts anything.
+ *
+ * An entry holds its inode open, so that the inode cannot be
+ * freed and its address reused by another file.  The inode's
+ * version tells whether the file was written since the page was
+ * read, which makes an idle frame stale.
+ *
+ * The frame table's lock, FRAME_LOCK in vm/vm.c, protects
+ * everything here. */
+
+/* Most frames kept while no process maps them. */
+#define IMAGE_IDLE_MAX 64
+
+/* A cached page of an executable. */
+struct image_entry {
+	struct hash_elem hash_elem;   /* Element in ENTRIES. */
+	struct inode *inode;          /* Executable, held open. */
+	unsigned version;             /* INODE's version when read. */
+	off_t ofs;                    /* Offset of the page in INODE. */
+	size_t read_bytes;            /* Bytes read, the rest zeroed. */
+	struct frame *frame;          /* Frame holding the page. */
+	struct list_elem idle_elem;   /* Element in IDLE, if idle. */
+};
+
+static struct hash entries;     /* All entries, by inode and offset. */
+static struct list idle;        /* Idle entries, oldest at the front. */
+static size_t entry_cnt;        /* Entries in ENTRIES. */
+
+/* Statistics. */
+static long long load_cnt;      /* Pages added after a disk read. */
+static long long reuse_cnt;     /* Pages mapped from the cache. */
+static long long reclaim_cnt;   /* Idle frames taken back. */
+
+static uint64_t
+image_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct image_entry *ie = hash_entry (e, struct image_entry,
+			hash_elem);
+	return hash_bytes (&ie->inode, sizeof ie->inode) ^ hash_int (ie->ofs);
+}
+
+static bool
+image_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct image_entry *a = hash_entry (a_, struct image_entry,
+			hash_elem);
+	const struct image_entry *b = hash_entry (b_, struct image_entry,
+			hash_elem);
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	return a->ofs < b->ofs;
+}
+
+/* Initializes the image cache. */
+void
+image_init (void) {
+	hash_init (&entries, image_hash, image_less, NULL);
+	list_init (&idle);
+	entry_cnt = 0;
+}
+
+/* Drops E, leaving its frame to the caller. */
+static void
+entry_remove (struct image_entry *e) {
+	hash_delete (&entries, &e->hash_elem);
+	if (e->frame->page_cnt == 0)
+		list_remove (&e->idle_elem);
+	e->frame->image = NULL;
+	entry_cnt--;
+	inode_close (e->inode);
+	free (e);
+}
+
+/* Returns the entry for OFS in INODE, or a null pointer. */
+static struct image_entry *
+entry_find (struct inode *inode, off_t ofs) {
+	struct image_entry key;
+	struct hash_elem *e;
+
+	key.inode = inode;
+	key.ofs = ofs;
+	e = hash_find (&entries, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct image_entry, hash_elem) : NULL;
+}
+
+/* Returns the frame holding the page at OFS in INODE, READ_BYTES
+ * of it read and the rest zeroed, or a null pointer if there is
+ * none.  An idle frame is no longer idle, and the caller must put
+ * it back on the frame table before linking a page to it. */
+struct frame *
+image_lookup (struct inode *inode, off_t ofs, size_t read_bytes) {
+	struct image_entry *e = entry_find (inode, ofs);
+
+	if (e == NULL || e->read_bytes != read_bytes
+			|| e->frame->pinned)
+		return NULL;
+	if (e->version != inode_get_version (inode)) {
+		/* Stale.  Leave a frame still in use to its pages, and
+		 * reclaim an idle one first. */
+		if (e->frame->page_cnt > 0)
+			image_forget (e->frame);
+		else {
+			list_remove (&e->idle_elem);
+			list_push_front (&idle, &e->idle_elem);
+		}
+		return NULL;
+	}
+	if (e->frame->page_cnt == 0)
+		list_remove (&e->idle_elem);
+	reuse_cnt++;
+	return e->frame;
+}
+
+/* Records that FRAME, which a page is linked to, holds the page at
+ * OFS in INODE, READ_BYTES of it read from INODE and the rest
+ * zeroed.  Does nothing if memory is short, or the cache already
+ * has that page in another frame. */
+void
+image_add (struct frame *frame, struct inode *inode, off_t ofs,
+		size_t read_bytes) {
+	struct image_entry *e;
+
+	ASSERT (frame->image == NULL);
+	ASSERT (frame->page_cnt > 0);
+
+	if (entry_find (inode, ofs) != NULL)
+		return;
+	e = malloc (sizeof *e);
+	if (e == NULL)
+		return;
+	e->inode = inode_reopen (inode);
+	e->version = inode_get_version (inode);
+	e->ofs = ofs;
+	e->read_bytes = read_bytes;
+	e->frame = frame;
+	hash_insert (&entries, &e->hash_elem);
+	frame->image = e;
+	entry_cnt++;
+	load_cnt++;
+}
+
+/* Drops FRAME from the cache, if it is there, as its contents are
+ * about to change. */
+void
+image_forget (struct frame *frame) {
+	if (frame->image != NULL)
+		entry_remove (frame->image);
+}
+
+/* FRAME has just lost its last page and is off the frame table.
+ * Returns the frame for the caller to free: FRAME, if it is not in
+ * the cache, or else the least recently used idle frame, if there
+ * are too many, or a null pointer. */
+struct frame *
+image_release (struct frame *frame) {
+	ASSERT (frame->page_cnt == 0);
+
+	if (frame->image == NULL)
+		return frame;
+	list_push_back (&idle, &frame->image->idle_elem);
+	if (list_size (&idle) <= IMAGE_IDLE_MAX)
+		return NULL;
+	return image_reclaim ();
+}
+
+/* Drops the least recently used idle frame from the cache and
+ * returns it, or a null pointer if no frame is idle. */
+struct frame *
+image_reclaim (void) {
+	struct image_entry *e;
+	struct frame *frame;
+
+	if (list_empty (&idle))
+		return NULL;
+	e = list_entry (list_front (&idle), struct image_entry, idle_elem);
+	frame = e->frame;
+	entry_remove (e);
+	reclaim_cnt++;
+	return frame;
+}
+
+/* Prints cache statistics. */
+void
+image_print_stats (void) {
+	struct hash_iterator i;
+	size_t shared = 0, mapped = 0;
+
+	hash_first (&i, &entries);
+	while (hash_next (&i)) {
+		struct image_entry *e = hash_entry (hash_cur (&i),
+				struct image_entry, hash_elem);
+		if (e->frame->page_cnt > 1) {
+			shared++;
+			mapped += e->frame->page_cnt;
+		}
+	}
+	printf ("Image cache: %zu pages (%zu idle), %zu shared by %zu "
+			"mappings, %lld loaded, %lld reused, %lld reclaimed\n",
+			entry_cnt, list_size (&idle), shared, mapped, load_cnt,
+			reuse_cnt, reclaim_cnt);
+}
@@ -0,0 +1,459 @@
+/* swap.c: Swap disk slot allocation and page I/O. */
+
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+#include "vm/zswap.h"
+
+/* The swap disk is divided into page-sized slots.
+ *
+ * Free slots are kept as a list of extents, runs of adjacent free
+ * slots sorted by position.  An allocation takes a whole run from
+ * the first extent after the previous allocation that is big
+ * enough, so pages evicted together land next to each other on
+ * disk and go out in one transfer.  A bitmap of slots in use
+ * answers membership questions in constant time.
+ *
+ * A slot written for a frame that several pages share is shared
+ * by those pages too, so each slot has a reference count, and
+ * reading a slot leaves its data in place until the last
+ * reference is dropped.
+ *
+ * Reading a slot also reads up to SWAP_READAHEAD - 1 slots after
+ * it that are in use, in the same transfer, into a small swap
+ * cache.  Pages evicted together tend to be needed together, so
+ * the faults on those pages are then served from memory.
+ *
+ * In front of the disk sits zswap, a pool of compressed pages.  A
+ * page that compresses well is kept there rather than written,
+ * although it still owns its slot.  When the pool fills up, its
+ * oldest pages are written back to their slots.
+ *
+ * SWAP_LOCK protects everything here and is held across disk I/O,
+ * which the disk channel serializes anyway. */
+
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Most slots read with one transfer. */
+#define SWAP_READAHEAD 8
+
+/* Pages in the swap cache. */
+#define SWAP_CACHE_SIZE 32
+
+/* A run of free slots. */
+struct swap_extent {
+	swap_slot_t start;          /* First slot. */
+	size_t cnt;                 /* Number of slots. */
+	struct list_elem elem;      /* Element in EXTENTS or SPARE. */
+};
+
+/* A page of readahead data. */
+struct swap_cache_entry {
+	swap_slot_t slot;           /* Slot cached, or SWAP_SLOT_NONE. */
+	void *kva;                  /* Page holding the data, or null. */
+};
+
+static struct disk *swap_disk;
+static size_t slot_cnt;             /* Slots on the swap disk. */
+static size_t free_cnt;             /* Slots not in use. */
+static struct bitmap *used_map;     /* Slots in use. */
+static unsigned *ref_cnt;           /* References to each slot in use. */
+static struct lock swap_lock;
+
+static struct list extents;         /* Free extents, by position. */
+static struct list spare;           /* Unused extent structures. */
+static struct list_elem *cursor;    /* Where the next search starts. */
+
+static struct swap_cache_entry cache[SWAP_CACHE_SIZE];
+static size_t cache_hand;           /* Next entry to reuse. */
+
+/* Pages that zswap writes back through. */
+static void *writeback_pages[SWAP_CLUSTER];
+
+/* Sector buffers for the transfer in progress. */
+static void *io_bufs[(SWAP_CLUSTER > SWAP_READAHEAD
+		? SWAP_CLUSTER : SWAP_READAHEAD) * SECTORS_PER_SLOT];
+
+/* Statistics. */
+static long long out_cnt, write_cnt;    /* Pages written, transfers. */
+static long long in_cnt, read_cnt;      /* Pages read, transfers. */
+static long long readahead_cnt;         /* Pages read ahead. */
+static long long hit_cnt;               /* Reads served from the cache. */
+static long long full_cnt;              /* Writes refused, swap full. */
+
+static swap_slot_t extent_alloc (size_t want, size_t *got);
+static void extent_free (swap_slot_t);
+static struct swap_cache_entry *cache_lookup (swap_slot_t);
+static struct swap_cache_entry *cache_claim (swap_slot_t);
+static void do_transfer (swap_slot_t, void *const pages[], size_t cnt,
+		bool write);
+static void write_runs (swap_slot_t slots[], void *pages[], size_t cnt);
+static bool store_compressed (swap_slot_t, void *page);
+
+/* Sets up swap on disk D, which may be null if there is no swap
+ * disk. */
+void
+swap_init (struct disk *d) {
+	size_t extent_max, i;
+	struct swap_extent *pool;
+
+	swap_disk = d;
+	slot_cnt = d != NULL ? disk_size (d) / SECTORS_PER_SLOT : 0;
+	lock_init (&swap_lock);
+	list_init (&extents);
+	list_init (&spare);
+	cursor = NULL;
+	for (i = 0; i < SWAP_CACHE_SIZE; i++) {
+		cache[i].slot = SWAP_SLOT_NONE;
+		cache[i].kva = NULL;
+	}
+	cache_hand = 0;
+	zswap_init (slot_cnt);
+	if (slot_cnt == 0)
+		return;
+
+	used_map = bitmap_create (slot_cnt);
+	ref_cnt = vmalloc (slot_cnt * sizeof *ref_cnt);
+
+	/* Free extents are separated by at least one slot in use, so
+	 * there can never be more than this many. */
+	extent_max = slot_cnt / 2 + 1;
+	pool = vmalloc (extent_max * sizeof *pool);
+	if (used_map == NULL || ref_cnt == NULL || pool == NULL)
+		PANIC ("swap_init: out of memory");
+	for (i = 0; i < extent_max; i++)
+		list_push_back (&spare, &pool[i].elem);
+	for (i = 0; i < SWAP_CLUSTER; i++) {
+		writeback_pages[i] = palloc_get_page (0);
+		if (writeback_pages[i] == NULL)
+			PANIC ("swap_init: out of memory");
+	}
+
+	pool = list_entry (list_pop_front (&spare), struct swap_extent, elem);
+	pool->start = 0;
+	pool->cnt = slot_cnt;
+	list_push_back (&extents, &pool->elem);
+	free_cnt = slot_cnt;
+}
+
+/* Writes the CNT pages PAGES[] to swap, storing the slot of each
+ * in SLOTS[].  CNT must not exceed SWAP_CLUSTER.  Pages that
+ * compress well go to zswap, and runs of adjacent slots among the
+ * rest are written with one transfer.  Returns the number of pages
+ * written, which is less than CNT, counting from the front, if
+ * swap runs out. */
+size_t
+swap_write (void *const pages[], size_t cnt, swap_slot_t slots[]) {
+	swap_slot_t disk_slots[SWAP_CLUSTER];
+	void *disk_pages[SWAP_CLUSTER];
+	size_t done = 0, disk_cnt = 0, i;
+
+	ASSERT (cnt <= SWAP_CLUSTER);
+
+	lock_acquire (&swap_lock);
+	while (done < cnt) {
+		size_t got;
+		swap_slot_t slot = extent_alloc (cnt - done, &got);
+
+		if (slot == SWAP_SLOT_NONE) {
+			full_cnt++;
+			break;
+		}
+		for (i = 0; i < got; i++) {
+			slots[done + i] = slot + i;
+			ref_cnt[slot + i] = 1;
+		}
+		done += got;
+	}
+
+	for (i = 0; i < done; i++)
+		if (!store_compressed (slots[i], pages[i])) {
+			disk_slots[disk_cnt] = slots[i];
+			disk_pages[disk_cnt] = pages[i];
+			disk_cnt++;
+		}
+	write_runs (disk_slots, disk_pages, disk_cnt);
+	out_cnt += done;
+	lock_release (&swap_lock);
+	return done;
+}
+
+/* Reads SLOT, which must be in use, into PAGE. */
+void
+swap_read (swap_slot_t slot, void *page) {
+	void *pages[SWAP_READAHEAD];
+	struct swap_cache_entry *ce;
+	size_t n;
+
+	lock_acquire (&swap_lock);
+	ASSERT (slot < slot_cnt && bitmap_test (used_map, slot));
+	in_cnt++;
+
+	if (zswap_load (slot, page)) {
+		lock_release (&swap_lock);
+		return;
+	}
+
+	ce = cache_lookup (slot);
+	if (ce != NULL) {
+		memcpy (page, ce->kva, PGSIZE);
+		hit_cnt++;
+		lock_release (&swap_lock);
+		return;
+	}
+
+	/* Read the following slots in use into the cache, in the same
+	 * transfer, as long as they are not there yet. */
+	pages[0] = page;
+	for (n = 1; n < SWAP_READAHEAD; n++) {
+		swap_slot_t next = slot + n;
+
+		if (next >= slot_cnt || !bitmap_test (used_map, next)
+				|| zswap_contains (next) || cache_lookup (next) != NULL)
+			break;
+		ce = cache_claim (next);
+		if (ce == NULL)
+			break;
+		pages[n] = ce->kva;
+	}
+	do_transfer (slot, pages, n, false);
+	readahead_cnt += n - 1;
+	lock_release (&swap_lock);
+}
+
+/* Adds a reference to SLOT, which must be in use. */
+void
+swap_dup (swap_slot_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (slot < slot_cnt && bitmap_test (used_map, slot));
+	ref_cnt[slot]++;
+	lock_release (&swap_lock);
+}
+
+/* Drops a reference to SLOT, which must be in use, and frees SLOT
+ * if that was the last one. */
+void
+swap_free (swap_slot_t slot) {
+	struct swap_cache_entry *ce;
+
+	lock_acquire (&swap_lock);
+	ASSERT (slot < slot_cnt && bitmap_test (used_map, slot));
+	if (--ref_cnt[slot] > 0) {
+		lock_release (&swap_lock);
+		return;
+	}
+	ce = cache_lookup (slot);
+	if (ce != NULL)
+		ce->slot = SWAP_SLOT_NONE;
+	zswap_invalidate (slot);
+	extent_free (slot);
+	lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) {
+	lock_acquire (&swap_lock);
+	printf ("Swap: %zu of %zu slots in use, %zu free extents, "
+			"%lld pages out in %lld writes, %lld pages in in %lld reads, "
+			"%lld read ahead, %lld cache hits, %lld refused\n",
+			slot_cnt - free_cnt, slot_cnt, list_size (&extents),
+			out_cnt, write_cnt, in_cnt, read_cnt, readahead_cnt, hit_cnt,
+			full_cnt);
+	zswap_print_stats ();
+	lock_release (&swap_lock);
+}
+
+/* Tries to keep PAGE for SLOT in zswap, first writing back the
+ * oldest compressed pages if zswap is full.  Returns true if PAGE
+ * was kept. */
+static bool
+store_compressed (swap_slot_t slot, void *page) {
+	if (zswap_needs_room ()) {
+		swap_slot_t slots[SWAP_CLUSTER];
+		size_t n = zswap_shrink (slots, writeback_pages, SWAP_CLUSTER);
+
+		write_runs (slots, writeback_pages, n);
+	}
+	return zswap_store (slot, page);
+}
+
+/* Writes the CNT pages PAGES[] to slots SLOTS[], which may come in
+ * any order, with one transfer per run of adjacent slots.
+ * Reorders both arrays. */
+static void
+write_runs (swap_slot_t slots[], void *pages[], size_t cnt) {
+	size_t i, j;
+
+	/* Insertion sort by slot; CNT is small. */
+	for (i = 1; i < cnt; i++) {
+		swap_slot_t s = slots[i];
+		void *p = pages[i];
+
+		for (j = i; j > 0 && slots[j - 1] > s; j--) {
+			slots[j] = slots[j - 1];
+			pages[j] = pages[j - 1];
+		}
+		slots[j] = s;
+		pages[j] = p;
+	}
+
+	for (i = 0; i < cnt; i = j) {
+		for (j = i + 1; j < cnt && slots[j] == slots[j - 1] + 1; j++)
+			continue;
+		do_transfer (slots[i], pages + i, j - i, true);
+	}
+}
+
+/* Moves the CNT pages PAGES[] to or from the CNT slots starting at
+ * SLOT, with one disk transfer. */
+static void
+do_transfer (swap_slot_t slot, void *const pages[], size_t cnt,
+		bool write) {
+	size_t i, j;
+
+	ASSERT (cnt * SECTORS_PER_SLOT <= sizeof io_bufs / sizeof *io_bufs);
+
+	for (i = 0; i < cnt; i++)
+		for (j = 0; j < SECTORS_PER_SLOT; j++)
+			io_bufs[i * SECTORS_PER_SLOT + j] =
+				(uint8_t *) pages[i] + j * DISK_SECTOR_SIZE;
+
+	if (write) {
+		disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+				cnt * SECTORS_PER_SLOT, (const void *const *) io_bufs);
+		write_cnt++;
+	} else {
+		disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+				cnt * SECTORS_PER_SLOT, io_bufs);
+		read_cnt++;
+	}
+}
+
+/* Allocates a run of up to WANT adjacent free slots, storing its
+ * length in *GOT, and returns its first slot.  Searches from the
+ * cursor for an extent that holds the whole run, and falls back to
+ * the largest extent.  Returns SWAP_SLOT_NONE if no slot is free.
+ * SWAP_LOCK must be held. */
+static swap_slot_t
+extent_alloc (size_t want, size_t *got) {
+	struct swap_extent *best = NULL;
+	struct list_elem *e;
+	swap_slot_t slot;
+	size_t take;
+
+	ASSERT (want > 0);
+
+	if (list_empty (&extents))
+		return SWAP_SLOT_NONE;
+	if (cursor == NULL || cursor == list_end (&extents))
+		cursor = list_begin (&extents);
+
+	e = cursor;
+	do {
+		struct swap_extent *x = list_entry (e, struct swap_extent, elem);
+
+		if (x->cnt >= want) {
+			best = x;
+			break;
+		}
+		if (best == NULL || x->cnt > best->cnt)
+			best = x;
+		e = list_next (e);
+		if (e == list_end (&extents))
+			e = list_begin (&extents);
+	} while (e != cursor);
+
+	take = want < best->cnt ? want : best->cnt;
+	slot = best->start;
+	best->start += take;
+	best->cnt -= take;
+	cursor = &best->elem;
+	if (best->cnt == 0) {
+		cursor = list_remove (&best->elem);
+		list_push_back (&spare, &best->elem);
+	}
+
+	bitmap_set_multiple (used_map, slot, take, true);
+	free_cnt -= take;
+	*got = take;
+	return slot;
+}
+
+/* Returns SLOT to the free extents, merging it with its
+ * neighbours.  SWAP_LOCK must be held. */
+static void
+extent_free (swap_slot_t slot) {
+	struct swap_extent *prev = NULL, *next = NULL;
+	struct list_elem *e;
+
+	for (e = list_begin (&extents); e != list_end (&extents);
+			e = list_next (e)) {
+		next = list_entry (e, struct swap_extent, elem);
+		if (next->start > slot)
+			break;
+		prev = next;
+		next = NULL;
+	}
+
+	if (prev != NULL && prev->start + prev->cnt == slot) {
+		prev->cnt++;
+		if (next != NULL && slot + 1 == next->start) {
+			prev->cnt += next->cnt;
+			if (cursor == &next->elem)
+				cursor = &prev->elem;
+			list_remove (&next->elem);
+			list_push_back (&spare, &next->elem);
+		}
+	} else if (next != NULL && slot + 1 == next->start) {
+		next->start--;
+		next->cnt++;
+	} else {
+		struct swap_extent *x;
+
+		ASSERT (!list_empty (&spare));
+		x = list_entry (list_pop_front (&spare), struct swap_extent, elem);
+		x->start = slot;
+		x->cnt = 1;
+		list_insert (e, &x->elem);
+	}
+
+	bitmap_reset (used_map, slot);
+	free_cnt++;
+}
+
+/* Returns the cache entry holding SLOT, or a null pointer. */
+static struct swap_cache_entry *
+cache_lookup (swap_slot_t slot) {
+	size_t i;
+
+	for (i = 0; i < SWAP_CACHE_SIZE; i++)
+		if (cache[i].slot == slot)
+			return &cache[i];
+	return NULL;
+}
+
+/* Takes the oldest cache entry for SLOT and returns it, or a null
+ * pointer if it has no page and none can be allocated. */
+static struct swap_cache_entry *
+cache_claim (swap_slot_t slot) {
+	struct swap_cache_entry *ce = &cache[cache_hand];
+
+	if (ce->kva == NULL) {
+		ce->kva = palloc_get_page (0);
+		if (ce->kva == NULL)
+			return NULL;
+	}
+	cache_hand = (cache_hand + 1) % SWAP_CACHE_SIZE;
+	ce->slot = slot;
+	return ce;
+}
@@ -10,6 +10,8 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
+#include "threads/slab.h"
+#include "userprog/process.h"
 
 static bool uninit_initialize (struct page *page, void *kva);
 static void uninit_destroy (struct page *page);
@@ -53,7 +55,13 @@ uninit_initialize (struct page *page, void *kva) {
 	void *aux = uninit->aux;
 
 	/* TODO: You may need to fix this function. */
-	return uninit->page_initializer (page, uninit->type, kva) && (init ? init (page, aux) : true);
+	bool success = uninit->page_initializer (page, uninit->type, kva)
+		&& (init ? init (page, aux) : true);
+
+	/* Each page has its own lazy_aux, needed no more. */
+	if (aux != NULL)
+		kmem_cache_free (lazy_aux_cache, aux);
+	return success;
 }
 
 /* Free the resources hold by uninit_page. Although most of pages are transmuted
@@ -65,8 +73,13 @@ uninit_destroy (struct page *page) {
 	struct uninit_page *uninit UNUSED = &page->uninit;
 	/* TODO: Fill this function.
 	 * TODO: If you don't have anything to do, just return. */
-	if(page != NULL) {
-		free(page);
+	struct lazy_aux *aux = uninit->aux;
+
+	/* A file page owns the file in its aux; see do_mmap(). */
+	if (aux != NULL) {
+		if (VM_TYPE (uninit->type) == VM_FILE)
+			file_close (aux->file);
+		kmem_cache_free (lazy_aux_cache, aux);
 	}
 }
 // 3-2 end
\ No newline at end of file
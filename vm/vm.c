@@ -1,4 +1,5 @@
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "filesys/filesys.h"
@@ -6,8 +7,54 @@
 // P3-1 start
 #include "hash.h"
 #include "threads/mmu.h"
-struct list frame_list;
+#include "userprog/process.h"
 // P3-1 end
+#include <string.h>
+#include "threads/synch.h"
+#include "vm/evict.h"
+#include "vm/swap.h"
+#include "vm/image.h"
+#include "threads/vmalloc.h"
+
+/* The frame table.  Every frame that holds user pages is on
+ * FRAME_TABLE, whichever process the pages belong to.  Each frame
+ * has a reverse map of the pages mapped onto it, more than one if
+ * a forked child still shares its parent's frame, so eviction can
+ * reach every page table that maps the frame.
+ *
+ * FRAME_LOCK protects the table, the reverse maps, the pinned
+ * flags and the replacement policy's state.  It is never held
+ * across disk I/O.  A frame that is being filled or evicted is
+ * pinned instead, which keeps the policy from choosing it, and
+ * FRAME_UNPINNED is signaled when the pin is dropped. */
+static struct list frame_table;
+static struct lock frame_lock;
+static struct condition frame_unpinned;
+
+/* Fault-around.  A fault on a page that is still to be read from
+ * a file also populates the pages after it that come from the
+ * following bytes of the same file, reading them all with one
+ * file_read_at() into a buffer of the fault's own.  The lazy
+ * loaders then copy their data out of that buffer through
+ * vm_file_read_at(), which finds it through the faulting process's
+ * SPT.  Each process adapts its own window: a fault right after
+ * the last populated range doubles it, up to FAULT_AROUND_MAX, and
+ * any other fault halves it, down to the faulting page alone. */
+#define FAULT_AROUND_MAX 16
+#define FAULT_AROUND_INIT 4
+
+/* File data read by vm_fault_around(). */
+struct fa_read {
+	struct inode *inode;        /* Inode the data came from. */
+	off_t ofs;                  /* File offset of BUF[0]. */
+	off_t len;                  /* Bytes of data in BUF. */
+	uint8_t *buf;
+};
+
+/* Object caches for the structures allocated on every fault. */
+static struct kmem_cache *page_cache;
+static struct kmem_cache *frame_cache;
+struct kmem_cache *lazy_aux_cache;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -22,8 +69,18 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	// 3-1 start
-	list_init (&frame_list);
+	list_init (&frame_table);
+	evict_init ();
+	image_init ();
+	lock_init (&frame_lock);
+	cond_init (&frame_unpinned);
 	// 3-1 end
+	page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+	lazy_aux_cache = kmem_cache_create ("lazy_aux",
+			sizeof (struct lazy_aux), NULL);
+	if (page_cache == NULL || frame_cache == NULL || lazy_aux_cache == NULL)
+		PANIC ("vm_init: cannot create object caches");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -43,7 +100,15 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_claim_image (struct page *page);
 static struct frame *vm_evict_frame (void);
+static void frame_link (struct frame *, struct page *);
+static struct frame *frame_unlink (struct page *);
+static void frame_remove (struct frame *);
+static void frame_free (struct frame *);
+static void frame_unpin (struct frame *);
+static void frame_wait (struct page *);
+static void frame_release (struct page *);
 
 // P3-2 start
 /* Create the pending page object with initializer. If you want to create a
@@ -62,7 +127,9 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		/* TODO: Create the page, fetch the initialier according to the VM type,
 		 * TODO: and then create "uninit" page struct by calling uninit_new. You
 		 * TODO: should modify the field after calling the uninit_new. */
-		struct page *p = malloc(sizeof(struct page));
+		struct page *p = kmem_cache_alloc (page_cache);
+		if (p == NULL)
+			goto err;
 		switch (VM_TYPE(type)){
 			case VM_ANON:
 				/* code */
@@ -74,6 +141,9 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		}
 
 		p -> writable = writable;
+		p -> owner = thread_current ();
+		p -> evicted = false;
+		p -> ghost = NULL;
 
 		/* TODO: Insert the page into the spt. */
 		spt_insert_page(spt, p);
@@ -126,64 +196,251 @@ spt_remove_page (struct supplemental_page_table *spt UNUSED,
 // P3-5 end
 
 // P3-2 start
-/* Get the struct frame, that will be evicted. */
+/* Get the struct frame, that will be evicted.
+ * The choice is up to the replacement policy, see vm/evict.c.
+ * FRAME_LOCK must be held. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
 	 /* TODO: The policy for eviction is up to you. */
+	return evict_victim ();
+}
+
+/* Returns the type of the pages on FRAME, which has at least one.
+ * Pages share a frame only with copies of themselves, so they all
+ * have the same type. */
+static enum vm_type
+frame_type (struct frame *frame) {
+	return page_get_type (list_entry (list_front (&frame->pages),
+				struct page, frame_elem));
+}
+
+/* Returns true if any page on FRAME was written through its
+ * mapping.  FRAME_LOCK must be held. */
+static bool
+frame_is_dirty (struct frame *frame) {
 	struct list_elem *e;
-	struct thread *curr = thread_current();
-	for(e = list_begin(&frame_list); e != list_end(&frame_list); e = list_next(e)) {
-		victim = list_entry(e, struct frame, frame_elem);
-		if (!pml4_is_accessed(curr->pml4, victim->page->va)) {
-			break;
-		}
-		pml4_set_accessed(curr->pml4, victim->page->va, 0);
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, frame_elem);
+		if (pml4_is_dirty (p->owner->pml4, p->va))
+			return true;
 	}
-	return victim;
+	return false;
+}
+
+/* Unmaps every page on the pinned FRAME, which holds file-backed
+ * pages, each writing itself back if it was written.  Returns true
+ * if all of them were. */
+static bool
+frame_swap_out_file (struct frame *frame) {
+	struct list_elem *e;
+	bool success = true;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e))
+		if (!swap_out (list_entry (e, struct page, frame_elem)))
+			success = false;
+	return success;
 }
 
-/* Evict one page and return the corresponding frame.
+/* Evict one frame and return it.
+ * The frame is returned pinned, with no pages mapped.  Every page
+ * sharing the victim is unmapped: anonymous pages, including those
+ * of executables, share one swap slot, and file-backed pages go
+ * back to their files.
+ * If the victim is anonymous, up to SWAP_CLUSTER - 1 more
+ * anonymous victims are evicted along with it, so that they go to
+ * swap in one transfer, and their frames are given back to the
+ * page allocator for the faults that follow.
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
+	struct frame *victims[SWAP_CLUSTER];
+	bool written[SWAP_CLUSTER];
+	size_t cnt = 0, done, i;
+
+	/* A pinned frame gains and loses no pages, so its reverse map
+	 * may be walked without FRAME_LOCK. */
+	lock_acquire (&frame_lock);
+	while (cnt < SWAP_CLUSTER) {
+		struct frame *f = vm_get_victim ();
+		bool anon;
+
+		if (f == NULL)
+			break;
+		anon = frame_type (f) == VM_ANON;
+		if (cnt > 0 && !anon)
+			break;
+		f->pinned = true;
+		image_forget (f);
+		victims[cnt] = f;
+		written[cnt] = anon || frame_is_dirty (f);
+		cnt++;
+		if (!anon)
+			break;
+	}
+	lock_release (&frame_lock);
+	if (cnt == 0)
+		return NULL;
 
 	/* TODO: swap out the victim and return the evicted frame. */
-	if(victim == NULL) {
-		return NULL;
+	if (frame_type (victims[0]) == VM_ANON)
+		done = anon_swap_out_cluster (victims, cnt);
+	else
+		done = frame_swap_out_file (victims[0]) ? 1 : 0;
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < cnt; i++) {
+		if (i < done) {
+			evict_remove (victims[i], true);
+			while (!list_empty (&victims[i]->pages)) {
+				struct page *p = list_entry (list_front (&victims[i]->pages),
+						struct page, frame_elem);
+
+				frame_unlink (p);
+				evict_count_eviction (p, written[i]);
+				written[i] = false;
+			}
+		}
+		if (i > 0 || done == 0)
+			victims[i]->pinned = false;
+		if (i > 0 && i < done)
+			frame_remove (victims[i]);
 	}
-	swap_out(victim -> page);
-	victim->page = NULL;
-	return victim;
+	cond_broadcast (&frame_unpinned, &frame_lock);
+	lock_release (&frame_lock);
+
+	for (i = 1; i < done; i++)
+		frame_free (victims[i]);
+	return done > 0 ? victims[0] : NULL;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it. That is, if the user pool memory is full, this function
+ * evicts the frame to get the available memory space.
+ * The frame is returned pinned; the caller unpins it with frame_unpin()
+ * once the page contents are in place.  Returns NULL if no frame can be
+ * allocated or evicted. */
 static struct frame *
 vm_get_frame (void) {
 	struct frame *frame = NULL;
 	/* TODO: Fill this function. */
-	frame = (struct frame *)malloc(sizeof(struct frame));	
-	// ASSERT (frame != NULL);
-	// ASSERT (frame->page == NULL);
-
-	struct page *p = palloc_get_page(PAL_USER); // user pool
-	if (p == NULL) {
-		frame = vm_evict_frame();
-		frame -> page = NULL;
-		return;
+	void *kva = palloc_get_page(PAL_USER); // user pool
+	if (kva == NULL) {
+		/* Idle executable pages go before any page in use. */
+		lock_acquire (&frame_lock);
+		frame = image_reclaim ();
+		if (frame != NULL) {
+			frame->pinned = true;
+			list_push_back (&frame_table, &frame->frame_elem);
+		}
+		lock_release (&frame_lock);
+		if (frame != NULL)
+			return frame;
+		return vm_evict_frame();
 	}
-	frame -> kva = p;
-	frame->page = NULL;
 
-	list_push_back(&frame_list, &frame->frame_elem);
+	frame = kmem_cache_alloc (frame_cache);
+	if (frame == NULL) {
+		palloc_free_page (kva);
+		return NULL;
+	}
+	frame -> kva = kva;
+	list_init (&frame->pages);
+	frame->page_cnt = 0;
+	frame->pinned = true;
+	frame->evict_list = NULL;
+	frame->image = NULL;
+
+	lock_acquire (&frame_lock);
+	list_push_back (&frame_table, &frame->frame_elem);
+	lock_release (&frame_lock);
 
 	return frame;
 }
 
+/* Adds PAGE to FRAME's reverse map.  FRAME_LOCK must be held. */
+static void
+frame_link (struct frame *frame, struct page *page) {
+	ASSERT (page->frame == NULL);
+
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->page_cnt++;
+	page->frame = frame;
+}
+
+/* Removes PAGE from its frame's reverse map.  If that leaves the
+ * frame unused and unpinned, also takes it off the frame table and
+ * hands it to the image cache, which returns a frame for the caller
+ * to pass to frame_free() after releasing FRAME_LOCK, or NULL.
+ * Otherwise returns NULL.  FRAME_LOCK must be held. */
+static struct frame *
+frame_unlink (struct page *page) {
+	struct frame *frame = page->frame;
+
+	ASSERT (frame != NULL);
+
+	list_remove (&page->frame_elem);
+	page->frame = NULL;
+	if (--frame->page_cnt > 0 || frame->pinned)
+		return NULL;
+	frame_remove (frame);
+	return image_release (frame);
+}
+
+/* Takes FRAME off the frame table.  FRAME_LOCK must be held. */
+static void
+frame_remove (struct frame *frame) {
+	evict_remove (frame, false);
+	list_remove (&frame->frame_elem);
+}
+
+/* Frees FRAME, which must be off the frame table. */
+static void
+frame_free (struct frame *frame) {
+	if (frame != NULL) {
+		palloc_free_page (frame->kva);
+		kmem_cache_free (frame_cache, frame);
+	}
+}
+
+/* Drops the pin on FRAME. */
+static void
+frame_unpin (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pinned);
+	frame->pinned = false;
+	cond_broadcast (&frame_unpinned, &frame_lock);
+	lock_release (&frame_lock);
+}
+
+/* Waits until PAGE's frame, if any, is not pinned, as it is while
+ * another process evicts it.  FRAME_LOCK must be held. */
+static void
+frame_wait (struct page *page) {
+	while (page->frame != NULL && page->frame->pinned)
+		cond_wait (&frame_unpinned, &frame_lock);
+}
+
+/* Unmaps PAGE and removes it from its frame, freeing the frame if
+ * no other page maps it. */
+static void
+frame_release (struct page *page) {
+	struct frame *frame = NULL;
+
+	lock_acquire (&frame_lock);
+	evict_forget (page);
+	frame_wait (page);
+	if (page->frame != NULL) {
+		if (page->owner->pml4 != NULL)
+			pml4_clear_page (page->owner->pml4, page->va);
+		frame = frame_unlink (page);
+	}
+	lock_release (&frame_lock);
+	frame_free (frame);
+}
+
 /* Growing the stack. */
 static void
 vm_stack_growth (void *addr UNUSED) {
@@ -193,20 +450,148 @@ vm_stack_growth (void *addr UNUSED) {
 	}
 }
 
+/* Makes PAGE writable if it is the only page left on its frame,
+ * which FRAME_LOCK must protect.  Returns false if PAGE shares the
+ * frame and must be copied. */
+static bool
+vm_unshare (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (page->frame == NULL || page->frame->page_cnt > 1)
+		return page->frame == NULL;
+	pml4_set_writable (page->owner->pml4, page->va, true);
+	return true;
+}
+
 /* Handle the fault on write_protected page */
 static bool
 vm_handle_wp (struct page *page UNUSED) {
 	// P3-extra
-	void *kva = page->frame->kva;
-	page->frame->kva = palloc_get_page(PAL_USER);
-	memcpy(page->frame->kva, kva, PGSIZE);
+	struct frame *frame;
+	struct frame *old = NULL;
+	bool copied = false;
+
+	/* The last sharer of a frame takes it over as it is.  So does a
+	 * page evicted meanwhile, which just faults again. */
+	lock_acquire (&frame_lock);
+	frame_wait (page);
+	if (vm_unshare (page)) {
+		lock_release (&frame_lock);
+		return true;
+	}
+	lock_release (&frame_lock);
+
+	frame = vm_get_frame ();
+	if (frame == NULL)
+		return false;
 
-	struct thread *t = thread_current();
-	pml4_set_page (t->pml4, page->va, page->frame->kva, page->parent_writable);
+	/* Copy the shared frame and move PAGE over to the copy, unless
+	 * the other sharers went away while we got FRAME. */
+	lock_acquire (&frame_lock);
+	frame_wait (page);
+	if (!vm_unshare (page)) {
+		memcpy (frame->kva, page->frame->kva, PGSIZE);
+		pml4_clear_page (page->owner->pml4, page->va);
+		old = frame_unlink (page);
+		frame_link (frame, page);
+		evict_add (frame, page);
+		copied = true;
+	} else
+		frame_remove (frame);
+	lock_release (&frame_lock);
+
+	if (!copied) {
+		frame_free (frame);
+		return true;
+	}
+	frame_free (old);
+
+	pml4_set_page (page->owner->pml4, page->va, frame->kva, true);
+	frame_unpin (frame);
 
 	return true;
 }
 
+/* Adjusts SPT's fault-around window for a fault at VA and returns
+ * it. */
+static size_t
+fault_around_window (struct supplemental_page_table *spt, void *va) {
+	if (va == spt->fa_next)
+		spt->fa_window = spt->fa_window * 2 < FAULT_AROUND_MAX
+			? spt->fa_window * 2 : FAULT_AROUND_MAX;
+	else if (spt->fa_window > 1)
+		spt->fa_window /= 2;
+	return spt->fa_window;
+}
+
+/* Claims PAGE, which is still to be read from a file, along with
+ * the pages after it that read the following bytes of the same
+ * file, as far as SPT's window goes. */
+static bool
+vm_fault_around (struct supplemental_page_table *spt, struct page *page) {
+	struct page *pages[FAULT_AROUND_MAX];
+	struct fa_read fa;
+	struct lazy_aux *aux = page->uninit.aux;
+	struct inode *inode = file_get_inode (aux->file);
+	size_t window = fault_around_window (spt, page->va);
+	size_t cnt = 1, read_bytes = aux->page_read_bytes, i;
+	bool success;
+
+	/* Only whole pages of file data can be followed by more. */
+	pages[0] = page;
+	while (cnt < window && read_bytes == cnt * PGSIZE) {
+		struct page *p = spt_find_page (spt, page->va + cnt * PGSIZE);
+		struct lazy_aux *a;
+
+		if (p == NULL || VM_TYPE (p->operations->type) != VM_UNINIT
+				|| p->uninit.init != page->uninit.init)
+			break;
+		a = p->uninit.aux;
+		if (file_get_inode (a->file) != inode
+				|| a->ofs != aux->ofs + (off_t) (cnt * PGSIZE))
+			break;
+		pages[cnt++] = p;
+		read_bytes += a->page_read_bytes;
+	}
+	spt->fa_next = page->va + cnt * PGSIZE;
+	if (cnt == 1)
+		return vm_do_claim_page (page);
+
+	/* Without a buffer, fall back to the faulting page alone. */
+	fa.buf = vmalloc (cnt * PGSIZE);
+	if (fa.buf == NULL)
+		return vm_do_claim_page (page);
+	fa.inode = inode;
+	fa.ofs = aux->ofs;
+	fa.len = file_read_at (aux->file, fa.buf, read_bytes, aux->ofs);
+	spt->fa_read = &fa;
+
+	/* The faulting page must succeed; the others are a bonus. */
+	success = vm_do_claim_page (pages[0]);
+	for (i = 1; success && i < cnt; i++)
+		if (!vm_do_claim_page (pages[i]))
+			break;
+
+	spt->fa_read = NULL;
+	vfree (fa.buf);
+	return success;
+}
+
+/* Reads SIZE bytes at OFS in FILE into BUFFER, as file_read_at(),
+ * but copies them from the fault-around buffer if vm_fault_around()
+ * has just read them there for the running process. */
+off_t
+vm_file_read_at (struct file *file, void *buffer, off_t size, off_t ofs) {
+	struct fa_read *fa = thread_current ()->spt.fa_read;
+
+	if (fa != NULL && file_get_inode (file) == fa->inode
+			&& ofs >= fa->ofs && ofs + size <= fa->ofs + fa->len) {
+		memcpy (buffer, fa->buf + (ofs - fa->ofs), size);
+		return size;
+	}
+	return file_read_at (file, buffer, size, ofs);
+}
+
 /* Return true on success */
 bool
 vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
@@ -236,14 +621,29 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	if(is_kernel_vaddr(page->va)) {
 		return false;
 	}
+
+	/* If another process is evicting the page, wait until it is out. */
+	lock_acquire (&frame_lock);
+	frame_wait (page);
+	lock_release (&frame_lock);
 	
 	// is access is an attempt to write to a read-only page
-	if(write && !not_present && page->parent_writable) {
+	if(write && !not_present && page->writable) {
 		return vm_handle_wp(page);
 	}
 	if(write && !page->writable) {
 		return false;
 	}
+	/* Already brought back in while we waited. */
+	if(page->frame != NULL) {
+		return true;
+	}
+	if(vm_claim_image (page)) {
+		return true;
+	}
+	if(VM_TYPE (page->operations->type) == VM_UNINIT && page->uninit.init != NULL) {
+		return vm_fault_around (spt, page);
+	}
 	
 	return vm_do_claim_page (page);
 }
@@ -255,7 +655,8 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 void
 vm_dealloc_page (struct page *page) {
 	destroy (page);
-	free (page);
+	frame_release (page);
+	kmem_cache_free (page_cache, page);
 }
 
 // P3-1 start
@@ -274,22 +675,106 @@ vm_claim_page (void *va UNUSED) {
 	return vm_do_claim_page (page);
 }
 
+/* Returns true if PAGE is a read-only page of an executable, still
+ * to be loaded, that the image cache can share. */
+static bool
+page_is_image (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& (page->uninit.type & VM_IMAGE) && !page->writable
+		&& page->uninit.aux != NULL;
+}
+
+/* Maps PAGE, if it is a page of an executable, onto the frame that
+ * holds it for another process, or held it for one that exited.
+ * Returns true if the image cache had such a frame. */
+static bool
+vm_claim_image (struct page *page) {
+	struct lazy_aux *aux;
+	struct frame *frame, *victim = NULL;
+
+	if (!page_is_image (page))
+		return false;
+	aux = page->uninit.aux;
+
+	/* Done under the lock, so that the frame cannot be evicted
+	 * before PAGE is initialized. */
+	lock_acquire (&frame_lock);
+	frame = image_lookup (file_get_inode (aux->file), aux->ofs,
+			aux->page_read_bytes);
+	if (frame != NULL) {
+		if (!pml4_set_page (page->owner->pml4, page->va, frame->kva, false)) {
+			if (frame->page_cnt == 0)
+				victim = image_release (frame);
+			frame = NULL;
+		} else {
+			/* A frame back from idle rejoins the frame table and
+			 * the replacement policy; one in use is on both. */
+			if (frame->page_cnt == 0) {
+				list_push_back (&frame_table, &frame->frame_elem);
+				evict_add (frame, page);
+			} else
+				evict_share (frame);
+			frame_link (frame, page);
+
+			/* The contents are there, just set PAGE up. */
+			page->uninit.init = NULL;
+			swap_in (page, frame->kva);
+		}
+	}
+	lock_release (&frame_lock);
+
+	frame_free (victim);
+	return frame != NULL;
+}
+
 /* Claim (allocate physical frame) the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	struct frame *frame;
+	bool success = false;
+	bool image = false;
+	struct inode *inode = NULL;
+	off_t ofs = 0;
+	size_t read_bytes = 0;
+
+	if (vm_claim_image (page))
+		return true;
+
+	/* Keep the key for the image cache, since loading PAGE frees its
+	 * aux. */
+	if (page_is_image (page)) {
+		struct lazy_aux *aux = page->uninit.aux;
+
+		image = true;
+		inode = file_get_inode (aux->file);
+		ofs = aux->ofs;
+		read_bytes = aux->page_read_bytes;
+	}
+
+	frame = vm_get_frame ();
+	if (frame == NULL)
+		return false;
+
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	lock_acquire (&frame_lock);
+	frame_link (frame, page);
+	evict_add (frame, page);
+	evict_count_fault (page);
+	lock_release (&frame_lock);
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	struct thread *t = thread_current ();
 	/* Verify that there's not already a page at that virtual
 	 * address, then map our page there. */
-	if (pml4_set_page (t->pml4, page->va, frame->kva, page->writable)) {
-		return swap_in (page, frame->kva); // WHY??
+	if (pml4_set_page (page->owner->pml4, page->va, frame->kva, page->writable)) {
+		success = swap_in (page, frame->kva); // WHY??
 	}
-	return false;
+	if (success && image) {
+		lock_acquire (&frame_lock);
+		image_add (frame, inode, ofs, read_bytes);
+		lock_release (&frame_lock);
+	}
+	frame_unpin (frame);
+	return success;
 }
 
 /* Initialize new supplemental page table */
@@ -313,30 +798,100 @@ bool less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux)
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	hash_init(&spt->spt_hash, hash_func, less_func, NULL);
+	spt->fa_next = NULL;
+	spt->fa_window = FAULT_AROUND_INIT;
+	spt->fa_read = NULL;
 }
 
 // P3-1 end
 
 // P3-2 start
 
-/* Claim (allocate physical frame) the PAGE and set up the mmu. */
+/* Maps PAGE, the child's copy of PARENT_PAGE, read-only onto
+ * PARENT_PAGE's frame, bringing that back in first if it was
+ * evicted, and write-protects PARENT_PAGE as well.  The frame's
+ * PAGE_CNT counts its sharers: the first write to either page
+ * copies the frame, unless that page is the last one left on it. */
 static bool
-vm_do_claim_page_copy (struct page *page, void *kva, bool writable) {
-	struct frame *frame = vm_get_frame();
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+vm_do_claim_page_copy (struct page *page, struct page *parent_page) {
+	struct frame *frame;
+	bool success = false;
+
+	for (;;) {
+		/* Set links, and set PAGE up before the frame can be
+		 * evicted from it. */
+		lock_acquire (&frame_lock);
+		frame_wait (parent_page);
+		frame = parent_page->frame;
+		if (frame != NULL) {
+			/* TODO: Insert page table entry to map page's VA to frame's PA. */
+			// set writable false
+			if (pml4_set_page (page->owner->pml4, page->va, frame->kva, 0)) {
+				frame_link (frame, page);
+				pml4_set_writable (parent_page->owner->pml4, parent_page->va,
+						false);
+				success = swap_in (page, frame->kva); // WHY??
+			}
+		}
+		lock_release (&frame_lock);
+		if (frame != NULL)
+			return success;
+		if (!vm_do_claim_page (parent_page))
+			return false;
+	}
+}
 
-	page->parent_writable = writable;
-	frame->kva = kva;
+/* Returns a new lazy_aux like AUX but for FILE, or a null pointer
+ * if memory is short. */
+static struct lazy_aux *
+lazy_aux_copy (const struct lazy_aux *aux, struct file *file) {
+	struct lazy_aux *copy = kmem_cache_alloc (lazy_aux_cache);
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	struct thread *t = thread_current ();
-	// set writable false
-	if (pml4_set_page (t->pml4, page->va, frame->kva, 0)) {
-		return swap_in (page, frame->kva); // WHY??
+	if (copy != NULL) {
+		*copy = *aux;
+		copy->file = file;
 	}
-	return false;
+	return copy;
+}
+
+/* Adds to the running thread's SPT a page like PAGE, still to be
+ * loaded by INIT from AUX, which the new page then owns.  A file
+ * page gets a file of its own, as do_mmap() gives each page. */
+static bool
+spt_copy_lazy (struct page *page, vm_initializer *init,
+		const struct lazy_aux *aux) {
+	enum vm_type type = VM_TYPE (page->operations->type) == VM_UNINIT
+		? page->uninit.type : page_get_type (page);
+	struct lazy_aux *copy = NULL;
+	struct file *file = NULL;
+
+	if (aux != NULL) {
+		/* Segments of the executable read the child's copy of it. */
+		if (VM_TYPE (type) == VM_FILE)
+			file = file_reopen (aux->file);
+		else if (aux->file == page->owner->running)
+			file = thread_current ()->running;
+		else
+			file = aux->file;
+		if (file == NULL)
+			return false;
+		copy = lazy_aux_copy (aux, file);
+		if (copy == NULL) {
+			if (VM_TYPE (type) == VM_FILE)
+				file_close (file);
+			return false;
+		}
+	}
+
+	if (!vm_alloc_page_with_initializer (type, page->va, page->writable,
+				init, copy)) {
+		if (VM_TYPE (type) == VM_FILE)
+			file_close (file);
+		if (copy != NULL)
+			kmem_cache_free (lazy_aux_cache, copy);
+		return false;
+	}
+	return true;
 }
 
 /* Copy supplemental page table from src to dst */
@@ -346,53 +901,50 @@ supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 	struct hash *h = &src->spt_hash;
 	struct hash_iterator i;
 
+	/* Pages not yet loaded are copied as they are, to be loaded by
+	 * the child on its own.  The others share their frames until one
+	 * side writes. */
 	hash_first (&i, h);
 	while (hash_next (&i))
 	{
 		struct page *page = hash_entry (hash_cur (&i), struct page, hash_elem);
+		struct lazy_aux aux;
 
-		enum vm_type type = page_get_type(page);
-		void *upage = page->va;
-		bool writable = page->writable;
-		vm_initializer *init = page->uninit.init;
-		void *aux = page->uninit.aux;
-
-		switch(page->operations->type) {
+		switch(VM_TYPE (page->operations->type)) {
 			case(VM_UNINIT):
-				if(page->uninit.type & VM_ANON) {
-
-					if(!vm_alloc_page_with_initializer(type, upage, writable, init, aux)){
-						return false;
-					};
-					// P3-extra
+				if(!spt_copy_lazy(page, page->uninit.init, page->uninit.aux)) {
+					return false;
 				}
 				break;
 			case(VM_ANON):
-				if(!vm_alloc_page(type, upage, writable)) {
+				if(!spt_copy_lazy(page, NULL, NULL)) {
 					return false;
 				}
-				// if(!vm_claim_page(upage)){
-				// 	return false;
-				// }
-				// struct page *new_page = spt_find_page(dst, upage);
-				// if(new_page == NULL) {
-				// 	return NULL;
-				// }
-				// memcpy(new_page->frame->kva, page->frame->kva, PGSIZE);
-
-				// start P3-extra
-				struct page *new_page = NULL;
-				/* TODO: Fill this function */
-				struct thread *curr = thread_current();
-
-				new_page = spt_find_page(&curr->spt, upage);
-				if(new_page == NULL) {
+				break;
+			case(VM_FILE):
+				/* An initialized file page still needs its file. */
+				aux.file = page->file.file;
+				aux.ofs = page->file.ofs;
+				aux.page_read_bytes = page->file.size;
+				aux.page_zero_bytes = PGSIZE - page->file.size;
+				if(!spt_copy_lazy(page, NULL, &aux)) {
 					return false;
 				}
-				vm_do_claim_page_copy (new_page, page->frame->kva, page->writable);
-				// end P3-extra
 				break;
+			default:
+				continue;
 		}
+
+		// start P3-extra
+		if (VM_TYPE (page->operations->type) != VM_UNINIT) {
+			struct page *new_page = spt_find_page (dst, page->va);
+
+			if (new_page == NULL
+					|| !vm_do_claim_page_copy (new_page, page)) {
+				return false;
+			}
+		}
+		// end P3-extra
 	}
 	return true;
 }
@@ -402,7 +954,7 @@ void
 spt_destroy (struct hash_elem *e, void *aux) {
 	struct page *page = hash_entry (e, struct page, hash_elem);
 	if(page != NULL){
-		destroy(page);
+		vm_dealloc_page(page);
 	}
 }
 
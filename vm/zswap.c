@@ -0,0 +1,342 @@
+/* zswap.c: Compressed in-memory swap tier. */
+
+#include "vm/zswap.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+/* Pages on their way to swap are compressed and kept in memory
+ * when they shrink to a quarter page or less, so that
+ * swapping them back in costs a decompression instead of a disk
+ * read.  Every page still gets a swap slot, which is the key of its
+ * entry here.  So when the pool reaches ZSWAP_POOL_BYTES, the
+ * least recently stored entries can be decompressed and written
+ * back to their slots on disk without allocating anything.
+ *
+ * The codec is a byte-oriented LZ77 in the style of LZ4: a
+ * sequence of literal runs each followed by a back reference,
+ * found through a hash table of 4-byte prefixes.  It does no
+ * entropy coding, which makes it fast both ways and still very
+ * effective on the zero-filled and regular data typical of user
+ * pages.
+ *
+ * The caller's lock, SWAP_LOCK in vm/swap.c, protects everything
+ * here. */
+
+/* Bytes of compressed data the pool may hold. */
+#define ZSWAP_POOL_BYTES (64 * PGSIZE)
+
+/* A compressed page. */
+struct zswap_entry {
+	swap_slot_t slot;           /* Swap slot the page belongs to. */
+	size_t len;                 /* Length of DATA. */
+	struct list_elem lru_elem;  /* Element in LRU. */
+	uint8_t data[];             /* Compressed page. */
+};
+
+/* Largest compressed page kept, so that its entry fits the largest
+ * malloc() block below a whole page. */
+#define ZSWAP_MAX_LEN (PGSIZE / 4 - sizeof (struct zswap_entry))
+
+static struct zswap_entry **entries;    /* Entry for each slot, or null. */
+static struct list lru;                 /* Oldest entry at the front. */
+static size_t pool_bytes;               /* Bytes of data in the pool. */
+static size_t page_cnt;                 /* Pages in the pool. */
+
+/* Statistics. */
+static long long store_cnt;             /* Pages stored. */
+static long long reject_cnt;            /* ...refused, too big. */
+static long long in_bytes, out_bytes;   /* Sizes before and after. */
+static long long lookup_cnt, hit_cnt;   /* Loads tried, found. */
+static long long writeback_cnt;         /* Entries moved to disk. */
+
+static size_t lz_compress (const uint8_t *src, size_t len,
+		uint8_t *dst, size_t cap);
+static bool lz_decompress (const uint8_t *src, size_t len,
+		uint8_t *dst, size_t cap);
+static void entry_remove (struct zswap_entry *);
+
+/* Sets up the pool for a swap disk of SLOT_CNT slots. */
+void
+zswap_init (size_t slot_cnt) {
+	list_init (&lru);
+	pool_bytes = page_cnt = 0;
+	entries = NULL;
+	if (slot_cnt > 0) {
+		entries = vzalloc (slot_cnt * sizeof *entries);
+		if (entries == NULL)
+			PANIC ("zswap_init: out of memory");
+	}
+}
+
+/* Compresses PAGE and keeps it for SLOT.  Returns false, keeping
+ * nothing, if PAGE does not compress well, or memory is short. */
+bool
+zswap_store (swap_slot_t slot, const void *page) {
+	static uint8_t buf[ZSWAP_MAX_LEN];
+	struct zswap_entry *e;
+	size_t len;
+
+	ASSERT (entries != NULL && entries[slot] == NULL);
+
+	len = lz_compress (page, PGSIZE, buf, sizeof buf);
+	if (len == 0 || pool_bytes + len > ZSWAP_POOL_BYTES) {
+		reject_cnt++;
+		return false;
+	}
+	e = malloc (sizeof *e + len);
+	if (e == NULL) {
+		reject_cnt++;
+		return false;
+	}
+	e->slot = slot;
+	e->len = len;
+	memcpy (e->data, buf, len);
+	list_push_back (&lru, &e->lru_elem);
+	entries[slot] = e;
+	pool_bytes += len;
+	page_cnt++;
+
+	store_cnt++;
+	in_bytes += PGSIZE;
+	out_bytes += len;
+	return true;
+}
+
+/* If SLOT is in the pool, decompresses it into PAGE and returns
+ * true.  Otherwise returns false.  The page stays in the pool
+ * until zswap_invalidate(), since other pages may share SLOT. */
+bool
+zswap_load (swap_slot_t slot, void *page) {
+	struct zswap_entry *e;
+	bool ok;
+
+	lookup_cnt++;
+	if (!zswap_contains (slot))
+		return false;
+	e = entries[slot];
+	ok = lz_decompress (e->data, e->len, page, PGSIZE);
+	ASSERT (ok);
+	hit_cnt++;
+	return true;
+}
+
+/* Returns true if SLOT is in the pool. */
+bool
+zswap_contains (swap_slot_t slot) {
+	return entries != NULL && entries[slot] != NULL;
+}
+
+/* Drops SLOT from the pool, if it is there. */
+void
+zswap_invalidate (swap_slot_t slot) {
+	if (zswap_contains (slot))
+		entry_remove (entries[slot]);
+}
+
+/* Returns true if the pool might not have room for another page. */
+bool
+zswap_needs_room (void) {
+	return !list_empty (&lru)
+		&& pool_bytes + ZSWAP_MAX_LEN > ZSWAP_POOL_BYTES;
+}
+
+/* Takes up to MAX of the oldest pages out of the pool,
+ * decompressing them into PAGES[] and storing their slots in
+ * SLOTS[], for the caller to write to disk.  Returns the number of
+ * pages taken. */
+size_t
+zswap_shrink (swap_slot_t slots[], void *pages[], size_t max) {
+	size_t n;
+
+	for (n = 0; n < max && !list_empty (&lru); n++) {
+		struct zswap_entry *e = list_entry (list_front (&lru),
+				struct zswap_entry, lru_elem);
+		bool ok = lz_decompress (e->data, e->len, pages[n], PGSIZE);
+
+		ASSERT (ok);
+		slots[n] = e->slot;
+		entry_remove (e);
+		writeback_cnt++;
+	}
+	return n;
+}
+
+/* Prints pool statistics. */
+void
+zswap_print_stats (void) {
+	printf ("Zswap: %zu pages in %zu bytes, %lld stored at %lld%% "
+			"of their size, %lld rejected, %lld of %lld loads hit, "
+			"%lld written back\n",
+			page_cnt, pool_bytes, store_cnt,
+			in_bytes > 0 ? out_bytes * 100 / in_bytes : 0, reject_cnt,
+			hit_cnt, lookup_cnt, writeback_cnt);
+}
+
+/* Drops E from the pool and frees it. */
+static void
+entry_remove (struct zswap_entry *e) {
+	list_remove (&e->lru_elem);
+	entries[e->slot] = NULL;
+	pool_bytes -= e->len;
+	page_cnt--;
+	free (e);
+}
+
+/* The codec.
+ *
+ * A compressed block is a series of sequences.  Each starts with a
+ * token byte whose high nibble is the number of literal bytes that
+ * follow and whose low nibble is the match length minus
+ * LZ_MIN_MATCH.  A nibble of 15 is continued by bytes that are
+ * added on, up to and including the first one that is not 255.
+ * The literals come next, then the 2-byte little-endian distance
+ * back to the match.  The last sequence has only literals. */
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_SKIP_SHIFT 5         /* Speeds up scans of random data. */
+
+/* 1 + position of the last place each hashed prefix was seen, or
+ * 0.  Positions within a page fit in 16 bits. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static uint32_t
+lz_read32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+static size_t
+lz_hash (uint32_t v) {
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Writes the continuation bytes of length N at DST + OP and
+ * returns the new OP. */
+static size_t
+lz_put_len (uint8_t *dst, size_t op, size_t n) {
+	for (; n >= 255; n -= 255)
+		dst[op++] = 255;
+	dst[op++] = n;
+	return op;
+}
+
+/* Writes a sequence of LIT_LEN literals from LIT followed, if MLEN
+ * is nonzero, by a match of MLEN bytes DIST back, at DST + OP.
+ * Returns the new OP, or 0 if that would pass CAP. */
+static size_t
+lz_emit (uint8_t *dst, size_t op, size_t cap, const uint8_t *lit,
+		size_t lit_len, size_t dist, size_t mlen) {
+	size_t ml = mlen > 0 ? mlen - LZ_MIN_MATCH : 0;
+
+	if (op + 1 + lit_len / 255 + 1 + lit_len + 2 + ml / 255 + 1 > cap)
+		return 0;
+
+	dst[op++] = (lit_len < 15 ? lit_len : 15) << 4 | (ml < 15 ? ml : 15);
+	if (lit_len >= 15)
+		op = lz_put_len (dst, op, lit_len - 15);
+	memcpy (dst + op, lit, lit_len);
+	op += lit_len;
+	if (mlen > 0) {
+		dst[op++] = dist & 0xff;
+		dst[op++] = dist >> 8;
+		if (ml >= 15)
+			op = lz_put_len (dst, op, ml - 15);
+	}
+	return op;
+}
+
+/* Compresses the LEN bytes at SRC into DST, which has room for CAP
+ * bytes.  Returns the compressed length, or 0 if it exceeds CAP. */
+static size_t
+lz_compress (const uint8_t *src, size_t len, uint8_t *dst, size_t cap) {
+	size_t ip = 0, anchor = 0, op = 0;
+
+	ASSERT (len <= PGSIZE);
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (ip + LZ_MIN_MATCH <= len) {
+		uint32_t seq = lz_read32 (src + ip);
+		size_t h = lz_hash (seq);
+		size_t ref = lz_table[h];
+		size_t mlen;
+
+		lz_table[h] = ip + 1;
+		if (ref == 0 || lz_read32 (src + ref - 1) != seq) {
+			ip += 1 + ((ip - anchor) >> LZ_SKIP_SHIFT);
+			continue;
+		}
+		ref--;
+
+		mlen = LZ_MIN_MATCH;
+		while (ip + mlen < len && src[ref + mlen] == src[ip + mlen])
+			mlen++;
+		op = lz_emit (dst, op, cap, src + anchor, ip - anchor, ip - ref, mlen);
+		if (op == 0)
+			return 0;
+		ip += mlen;
+		anchor = ip;
+	}
+	return lz_emit (dst, op, cap, src + anchor, len - anchor, 0, 0);
+}
+
+/* Reads continuation bytes of a length from SRC + *IP, adding them
+ * to *N.  Returns false if SRC ends first. */
+static bool
+lz_get_len (const uint8_t *src, size_t len, size_t *ip, size_t *n) {
+	uint8_t b;
+
+	do {
+		if (*ip >= len)
+			return false;
+		b = src[(*ip)++];
+		*n += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses the LEN bytes at SRC into exactly CAP bytes at DST.
+ * Returns false if SRC is malformed. */
+static bool
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst, size_t cap) {
+	size_t ip = 0, op = 0;
+
+	while (ip < len) {
+		uint8_t token = src[ip++];
+		size_t lit = token >> 4;
+		size_t mlen = token & 15;
+		size_t dist;
+
+		if (lit == 15 && !lz_get_len (src, len, &ip, &lit))
+			return false;
+		if (ip + lit > len || op + lit > cap)
+			return false;
+		memcpy (dst + op, src + ip, lit);
+		ip += lit;
+		op += lit;
+		if (ip == len)
+			break;
+
+		if (ip + 2 > len)
+			return false;
+		dist = src[ip] | src[ip + 1] << 8;
+		ip += 2;
+		if (mlen == 15 && !lz_get_len (src, len, &ip, &mlen))
+			return false;
+		mlen += LZ_MIN_MATCH;
+		if (dist == 0 || dist > op || op + mlen > cap)
+			return false;
+
+		/* Byte by byte, since the match may overlap its copy. */
+		for (; mlen > 0; mlen--, op++)
+			dst[op] = dst[op - dist];
+	}
+	return op == cap;
+}